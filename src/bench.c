@@ -0,0 +1,290 @@
+#ifndef BENCH
+#define BENCH
+
+// Headless world generation and meshing benchmark.
+// Never creates a window or GL context, so meshes are handed to a discard or checksum sink instead of the GPU.
+
+#include "cglm/cglm.h"
+#include "chunk.c"
+#include "world.c"
+#include "misc.c"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define MAX_SWEEP_VALUES 16
+#define HEADLESS_FRAMES (4 * CHUNK_SIZE) // Camera moves one voxel per frame, so this crosses 4 chunk borders
+
+typedef struct BenchOptions {
+    int render_distance;
+    int world_height;
+    int seed;
+    MeshSink mesh_sink;
+    char *trace_path;
+    double memory_budget_mb; // Applied to the worlds of sweep mode, 0 for no limit
+    // Sweep mode, every combination of the two lists is benchmarked
+    int sweep_rds[MAX_SWEEP_VALUES];
+    int sweep_rd_count;
+    int sweep_whs[MAX_SWEEP_VALUES];
+    int sweep_wh_count;
+} BenchOptions;
+
+void printBenchUsage(char *name) {
+    printf("Usage: %s [--rd <render distance>] [--wh <world height>] [--seed <seed>] [--sink <discard|checksum>] [--storage <flat|palette|rle|tree>] [--trace <file>] [--memory-budget <MB>] [--sweep-rd <a,b,...>] [--sweep-wh <a,b,...>]\n", name);
+}
+
+// Parses a comma separated list like "1,2,4", returns the number of values read
+int parseSweepList(char *list, int *values) {
+    int count = 0;
+    char *token = strtok(list, ",");
+    while (token != NULL && count < MAX_SWEEP_VALUES) {
+        values[count++] = atoi(token);
+        token = strtok(NULL, ",");
+    }
+    return count;
+}
+
+int parseBenchOptions(int argc, char **argv, BenchOptions *options) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) { printBenchUsage(argv[0]); return 0; }
+
+        if      (strcmp(argv[i], "--rd") == 0)   { options->render_distance = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "--wh") == 0)   { options->world_height = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "--seed") == 0) { options->seed = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "--trace") == 0) { options->trace_path = argv[++i]; }
+        else if (strcmp(argv[i], "--memory-budget") == 0) { options->memory_budget_mb = atof(argv[++i]); }
+        else if (strcmp(argv[i], "--sweep-rd") == 0) { options->sweep_rd_count = parseSweepList(argv[++i], options->sweep_rds); }
+        else if (strcmp(argv[i], "--sweep-wh") == 0) { options->sweep_wh_count = parseSweepList(argv[++i], options->sweep_whs); }
+        else if (strcmp(argv[i], "--storage") == 0) { if (!parseStorageMode(argv[++i], &default_storage_mode)) { return 0; } }
+        else if (strcmp(argv[i], "--sink") == 0) {
+            i++;
+            if      (strcmp(argv[i], "discard") == 0)  { options->mesh_sink = discardMeshSink; }
+            else if (strcmp(argv[i], "checksum") == 0) { options->mesh_sink = checksumMeshSink; }
+            else { printf("ERROR: Unknown mesh sink \"%s\"\n", argv[i]); return 0; }
+        }
+        else { printBenchUsage(argv[0]); return 0; }
+    }
+
+    if (options->render_distance < 1 || options->world_height < 1) {
+        printf("ERROR: Render distance and world height must be at least 1\n");
+        return 0;
+    }
+
+    return 1;
+}
+
+// Remeshes every chunk in the world at a single LOD and reports throughput
+void benchChunkLOD(World *world, int lod) {
+    int lod_scale = pow(2, lod);
+    long voxels_per_chunk = (CHUNK_SIZE / lod_scale) * (CHUNK_SIZE / lod_scale) * (CHUNK_SIZE / lod_scale);
+    long faces = 0;
+
+    current_world = world;
+    beginCounterFrame();
+    double start = getPreciseTimeStamp();
+
+    for (int i = 0; i < world->chunks.size; i++) {
+        remeshWorldChunk(world, i, lod);
+        faces += ((SSBOBundle *) world->chunk_bundles.vals)[i].length;
+    }
+
+    double elapsed = getPreciseTimeStamp() - start;
+    endCounterFrame();
+    long chunks = world->chunks.size;
+
+    printf("LOD %d | %8.3f ms | %10.1f chunks/s | %12.0f voxels/s | %12.0f faces/s | %ld faces | %llu reallocs\n",
+           lod, elapsed * 1000.,
+           chunks / elapsed,
+           chunks * voxels_per_chunk / elapsed,
+           faces / elapsed,
+           faces,
+           counters.deltas[COUNTER_VECTOR_REALLOCS]);
+}
+
+// Rebuilds the LOD occupancy pyramid of every chunk, a neighbour heavy pass over the occupancy masks
+void benchLODPyramid(World *world) {
+    double start = getPreciseTimeStamp();
+    for (int i = 0; i < world->chunks.size; i++) {
+        buildChunkLODOccupancy(getWorldChunk(world, i));
+    }
+    double elapsed = getPreciseTimeStamp() - start;
+
+    printf("Pyramid | %8.3f ms | %10.1f chunks/s\n", elapsed * 1000., world->chunks.size / elapsed);
+}
+
+#define BENCH_RAYS_PER_CHUNK 64
+
+// Casts the same downward rays through the storage of every chunk. Hits and the hit checksum must not depend on the storage mode
+void benchRaycast(World *world) {
+    long hits = 0;
+    unsigned long long hit_sum = 0;
+    double start = getPreciseTimeStamp();
+
+    for (int i = 0; i < world->chunks.size; i++) {
+        Chunk *chunk = getWorldChunk(world, i);
+        for (int ray = 0; ray < BENCH_RAYS_PER_CHUNK; ray++) {
+            float origin[3] = {(ray % 8 + 0.5) * CHUNK_SIZE / 8., CHUNK_SIZE - 0.5, (ray / 8 + 0.5) * CHUNK_SIZE / 8.};
+            float dir[3] = {(ray % 3 - 1) * 0.37, -1., ((ray / 3) % 3 - 1) * 0.29};
+            unsigned int hit_index;
+            if (raycastStorage(&chunk->data->storage, origin, dir, CHUNK_SIZE * 2, &hit_index)) {
+                hits++;
+                hit_sum += hit_index;
+            }
+        }
+    }
+
+    double elapsed = getPreciseTimeStamp() - start;
+    long rays = world->chunks.size * BENCH_RAYS_PER_CHUNK;
+    printf("Raycast | %8.3f ms | %10.1f rays/s | %ld hits | %016llx\n", elapsed * 1000., rays / elapsed, hits, hit_sum);
+}
+
+// Drops the region at the origin and streams it back in, the chunk count must come back unchanged
+void benchRegionReload(World *world) {
+    ivec3 region_pos = {0, 0, 0};
+    long chunks = world->chunks.size;
+
+    double start = getPreciseTimeStamp();
+    unloadRegion(world, region_pos);
+    double unload_time = getPreciseTimeStamp() - start;
+    long unloaded = chunks - world->chunks.size;
+
+    start = getPreciseTimeStamp();
+    loadRegion(world, region_pos);
+    double load_time = getPreciseTimeStamp() - start;
+
+    printf("Region  | unload %8.3f ms | load %8.3f ms | %ld chunks | %s\n", unload_time * 1000., load_time * 1000., unloaded,
+           world->chunks.size == chunks ? "restored" : "MISMATCH");
+}
+
+// Moves the camera across chunk borders and times what a frame costs without a GPU, tickWorld (LOD updates and streaming) plus view culling
+void benchHeadlessFrames(World *world, double *average, double *worst) {
+    vec3 cam_pos = {0.5, world->world_height * CHUNK_SIZE / 2., 0.5};
+    vec3 view_dir = {1, 0, 0};
+    double total = 0;
+    *worst = 0;
+
+    for (int frame = 0; frame < HEADLESS_FRAMES; frame++) {
+        double start = getPreciseTimeStamp();
+
+        tickWorld(world, cam_pos);
+        int visible = 0;
+        ivec3 *positions = world->chunk_positions.vals;
+        uint8_t *meshed = world->chunk_meshed.vals;
+        unsigned long *last_used = world->chunk_last_used.vals;
+        SSBOBundle *bundles = world->chunk_bundles.vals;
+        for (int i = 0; i < world->chunks.size; i++) {
+            if (!meshed[i] || !chunkInView(positions[i], view_dir, cam_pos)) { continue; }
+            last_used[i] = world->tick; // Same as renderWorld, empty chunks in view count as used but are not drawn
+            if (bundles[i].length != 0) { visible++; }
+        }
+        world->chunk_render_count = visible;
+
+        double elapsed = getPreciseTimeStamp() - start;
+        total += elapsed;
+        if (elapsed > *worst) { *worst = elapsed; }
+
+        cam_pos[0] += 1;
+    }
+
+    *average = total / HEADLESS_FRAMES;
+}
+
+#define SWEEP_RESULT_SIZE 256 // One CSV line
+
+void runSweep(BenchOptions *options) {
+    if (options->sweep_rd_count == 0) { options->sweep_rds[options->sweep_rd_count++] = options->render_distance; }
+    if (options->sweep_wh_count == 0) { options->sweep_whs[options->sweep_wh_count++] = options->world_height; }
+
+    Vector results = vectorInit(SWEEP_RESULT_SIZE, options->sweep_rd_count * options->sweep_wh_count);
+
+    for (int r = 0; r < options->sweep_rd_count; r++) {
+        for (int w = 0; w < options->sweep_wh_count; w++) {
+            int rd = options->sweep_rds[r], wh = options->sweep_whs[w];
+
+            World world = createWorld(rd, wh, (ivec2) {0, 0}, options->seed, options->mesh_sink);
+            world.memory_budget = options->memory_budget_mb * 1048576.;
+            populateWorld(&world, 0);
+
+            long faces = 0;
+            for (int i = 0; i < world.chunks.size; i++) { faces += ((SSBOBundle *) world.chunk_bundles.vals)[i].length; }
+
+            double frame_average, frame_worst;
+            benchHeadlessFrames(&world, &frame_average, &frame_worst);
+
+            char result[SWEEP_RESULT_SIZE];
+            if (snprintf(result, SWEEP_RESULT_SIZE, "%d,%d,%zu,%.3f,%.3f,%.3f,%.3f,%ld,%.4f,%.4f",
+                         rd, wh, world.chunks.size,
+                         world.generation_time * 1000., world.meshing_time * 1000.,
+                         getTrackedMemoryTotal() / 1048576., getResidentMemory() / 1048576.,
+                         faces, frame_average * 1000., frame_worst * 1000.) < 0) { result[0] = '\0'; }
+            vectorPush(&results, result);
+
+            freeWorld(&world);
+        }
+    }
+
+    printf("\nrd,wh,chunks,generation_ms,meshing_ms,tracked_mb,resident_mb,faces,frame_avg_ms,frame_max_ms\n");
+    for (size_t i = 0; i < results.size; i++) {
+        char *result = vectorIndex(&results, i);
+        if (result[0] == '\0') { printf("ERROR: Could not format sweep result.\n"); continue; }
+        printf("%s\n", result);
+    }
+
+    freeVector(&results);
+}
+
+int main(int argc, char **argv) {
+    BenchOptions options = {
+        .render_distance = 1,
+        .world_height = 4,
+        .seed = 100,
+        .mesh_sink = checksumMeshSink,
+        .trace_path = NULL,
+        .memory_budget_mb = 0,
+        .sweep_rd_count = 0,
+        .sweep_wh_count = 0
+    };
+    if (!parseBenchOptions(argc, argv, &options)) { return -1; }
+    if (options.trace_path != NULL) { startTrace(); }
+
+    if (options.sweep_rd_count > 0 || options.sweep_wh_count > 0) {
+        runSweep(&options);
+        if (options.trace_path != NULL) { writeTrace(options.trace_path); }
+        return 0;
+    }
+
+    beginCounterFrame();
+    World world = createWorld(options.render_distance, options.world_height, (ivec2) {0, 0}, options.seed, options.mesh_sink);
+    populateWorld(&world, 0);
+    endCounterFrame();
+    long chunks = world.chunks.size;
+
+    printf("\nWorld: RD %d, WH %d, %ld chunks, %d^3 %s layout\n", options.render_distance, options.world_height, chunks, CHUNK_SIZE, VOXEL_LAYOUT_NAME);
+    printf("Generation: %8.3f ms (%.1f chunks/s)\n", world.generation_time * 1000., chunks / world.generation_time);
+    printf("Meshing:    %8.3f ms (%.1f chunks/s)\n", world.meshing_time * 1000., chunks / world.meshing_time);
+    if (options.mesh_sink == checksumMeshSink) { printf("Checksum:   %016llx\n", (unsigned long long) mesh_checksum); }
+
+    char counter_string[256];
+    getCounterString(counter_string, sizeof(counter_string));
+    printf("Counters:   %s\n", counter_string);
+
+    printf("\n");
+    for (int lod = 0; lod <= log2(CHUNK_SIZE); lod++) {
+        benchChunkLOD(&world, lod);
+    }
+    benchLODPyramid(&world);
+    benchRaycast(&world);
+    benchRegionReload(&world);
+
+    printf("\n");
+    printMemoryReport();
+    if (options.trace_path != NULL) { writeTrace(options.trace_path); }
+
+    freeWorld(&world);
+
+    return 0;
+}
+
+#endif
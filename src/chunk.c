@@ -4,33 +4,74 @@
 #include "engine.c"
 #include "vector.c"
 #include "noise.c"
+#include "trace.c"
+#include "storage.c"
+#include "pool.c"
 
 #include "cglm/cglm.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
-#define CHUNK_SIZE 16
-// Max 16 since we then only need 4 bits per axis to represent position
+// 4 for 16^3 chunks, 5 for 32^3 (CMake option CHUNK_SIZE_32). VoxelData has 5 bits per axis, so 32 is the max
+#ifndef CHUNK_SIZE_BITS
+#define CHUNK_SIZE_BITS 4
+#endif
+// Occupancy masks are whole 64 bit words, so a chunk needs at least 4^3 voxels (8^3 for Morton order, which works on 64 voxel blocks)
+#if CHUNK_SIZE_BITS < 2 || CHUNK_SIZE_BITS > 5
+#error "CHUNK_SIZE_BITS must be between 2 and 5"
+#endif
+#if defined(CHUNK_MORTON_ORDER) && CHUNK_SIZE_BITS < 3
+#error "CHUNK_MORTON_ORDER needs CHUNK_SIZE_BITS of at least 3"
+#endif
+#define CHUNK_SIZE (1 << CHUNK_SIZE_BITS)
+#define CHUNK_VOLUME (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)
+#define CHUNK_OCCUPANCY_WORDS (CHUNK_VOLUME / 64)
+#define CHUNK_MAX_LOD CHUNK_SIZE_BITS // log2(CHUNK_SIZE), the coarsest LOD is a single cell
+// Bit offset of each coarse level in the LOD occupancy pyramid, levels 1..CHUNK_MAX_LOD are packed back to back (8^3, 4^3, 2^3, 1^3 for CHUNK_SIZE 16)
+#define lodOccupancyOffset(level) ((CHUNK_VOLUME - (CHUNK_VOLUME >> (3 * ((level) - 1)))) / 7)
+#define CHUNK_LOD_OCCUPANCY_WORDS ((lodOccupancyOffset(CHUNK_MAX_LOD + 1) + 63) / 64)
 #define VALS_PER_VOXEL 1
 // #define FACES_PER_VOXEL 6
 #define VERTS_PER_FACE 6
 
-typedef enum Voxel {
-    OCCUPIED,
-    EMPTY
-} Voxel;
+// Voxels (see storage.c) are block IDs indexing the material table
+enum BlockID {
+    BLOCK_AIR,
+    BLOCK_STONE,
+    BLOCK_DIRT,
+    BLOCK_GRASS,
+    BLOCK_SNOW,
+    BLOCK_COUNT
+};
+
+typedef struct Material {
+    const char *name;
+    int opaque;
+    int color[3]; // 4 bits per channel (0 - 15)
+} Material;
 
+// Air must stay the only block that is not opaque, tree chunks mesh their LODs from the tree's non-empty masks (see chunkCellAny)
+const Material materials[BLOCK_COUNT] = {
+    [BLOCK_AIR]   = { "air",   0, {0, 0, 0} },
+    [BLOCK_STONE] = { "stone", 1, {8, 8, 8} },
+    [BLOCK_DIRT]  = { "dirt",  1, {9, 7, 5} },
+    [BLOCK_GRASS] = { "grass", 1, {7, 12, 5} },
+    [BLOCK_SNOW]  = { "snow",  1, {15, 15, 15} }
+};
+
+// Unpacked in basic_vert.glsl, keep the two in sync
 typedef struct VoxelData {
-    uint x : 4;
-    uint y : 4;
-    uint z : 4;
+    uint x : 5;
+    uint y : 5;
+    uint z : 5;
     uint r : 4;
     uint g : 4;
     uint b : 4;
     uint face_id: 3;
-    uint flags : 5;
+    uint flags : 2;
 } VoxelData;
 
 // Face table:
@@ -41,128 +82,292 @@ typedef struct VoxelData {
 // 4 : z+
 // 5 : z-
 
+// Cold per chunk data, only touched by generation, meshing and voxel lookups
+// Allocated from chunk_data_pool
+typedef struct ChunkData {
+    ChunkStorage storage; // Voxel block IDs
+    uint64_t occupancy[CHUNK_OCCUPANCY_WORDS]; // 1 bit per voxel, set when opaque. Indexed the same as the storage
+    // Downsampled occupancy per LOD level, built after generation. A cell is "any" if some voxel in it is opaque, "full" if all are.
+    // Meshing at a LOD emits the "any" cells, and only hides faces against another chunk's "full" cells so LOD borders never open holes.
+    uint64_t lod_any[CHUNK_LOD_OCCUPANCY_WORDS];
+    uint64_t lod_full[CHUNK_LOD_OCCUPANCY_WORDS];
+} ChunkData;
+
+#define CHUNK_POOL_SLAB_ITEMS 64
+
+Pool chunk_data_pool = poolInit(sizeof(ChunkData), CHUNK_POOL_SLAB_ITEMS, MEMORY_CHUNK_VOXELS);
+
+// The world keeps copies of the fields its per frame loops read in per slot arrays (see World), the voxels are in data
 typedef struct Chunk {
     ivec3 chunk_pos;
-    Voxel voxels[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+    int lod; // Level of detail, for CHUNK_SIZE 16 we have 0 (16 x 16), 1 (8 x 8), 2 (4 x 4), 3 (2, 2), 4 (1, 1). Up to CHUNK_MAX_LOD
+    int lod_scale; // LOD scale = pow(2, lod)
+    int meshed; // 0 until the first createChunkMesh, fast start defers this
     SSBOBundle buffer_bundle;
     mat4 model;
-    int lod; // Level of detail, for CHUNK_SIZE 16 we have 0 (16 x 16), 1 (8 x 8), 2 (4 x 4), 3 (2, 2), 4 (1, 1)
-    int lod_scale; // LOD scale = pow(2, lod)
+    ChunkData *data;
 } Chunk;
 
+// Chunks are pooled as well, the world only keeps pointers to them, so a Chunk * stays valid for as long as the chunk is loaded
+Pool chunk_pool = poolInit(sizeof(Chunk), CHUNK_POOL_SLAB_ITEMS, MEMORY_CHUNK_VECTOR);
+
+// Answers whether the LOD cell containing a world position is fully opaque (at lod 0 just the voxel), used by the mesher across chunk borders
+typedef uint (*OpaqueFunction)(ivec3 pos, int lod);
+
 SSBOBundle createBuffers(Vector *voxel_data) {
     return createSSBOBundle(voxel_data->vals, voxel_data->size * voxel_data->item_size, voxel_data->size, 0);
 }
 
-#define getVoxelIndex(x, y, z) (x * CHUNK_SIZE * CHUNK_SIZE + y * CHUNK_SIZE + z)
-#define getOffsetIndex(index, x_offset, y_offset, z_offset) (index + (CHUNK_SIZE * CHUNK_SIZE * x_offset) + (CHUNK_SIZE * y_offset) + z_offset)
+// Mesh sinks receive the finished face data of a chunk, and return the bundle the chunk will render with.
+// Only uploadMeshSink touches GL, the others let the mesher run without a context (see bench.c).
+typedef SSBOBundle (*MeshSink)(Vector *voxel_data);
+
+SSBOBundle uploadMeshSink(Vector *voxel_data) {
+    return createBuffers(voxel_data);
+}
+
+SSBOBundle discardMeshSink(Vector *voxel_data) {
+    return (SSBOBundle) { .SSBO = 0, .length = voxel_data->size, .size = 0 };
+}
+
+// FNV-1a over every face emitted, so mesher changes can be checked for identical output
+uint64_t mesh_checksum = 14695981039346656037ULL;
+SSBOBundle checksumMeshSink(Vector *voxel_data) {
+    unsigned char *bytes = voxel_data->vals;
+    for (size_t i = 0; i < voxel_data->size * voxel_data->item_size; i++) {
+        mesh_checksum ^= bytes[i];
+        mesh_checksum *= 1099511628211ULL;
+    }
+
+    return (SSBOBundle) { .SSBO = 0, .length = voxel_data->size, .size = 0 };
+}
+
+// Linear or Morton order depending on CHUNK_MORTON_ORDER, see layout.c
+#define getVoxelIndex(x, y, z) encodeVoxelIndex(CHUNK_SIZE, x, y, z)
 #define getOffsetIvec3(vec, x_offset, y_offset, z_offset) ((ivec3) {vec[0] + x_offset, vec[1] + y_offset, vec[2] + z_offset})
 #define getVoxelPos(x, y, z, chunk_pos) {x + CHUNK_SIZE * chunk_pos[0], y + CHUNK_SIZE * chunk_pos[1], z + CHUNK_SIZE * chunk_pos[2]}
 
-void generateNewChunk(Chunk *chunk, int world_height) {
+uint opaqueVoxel(Voxel voxel) {
+    return materials[voxel].opaque;
+}
+
+#define chunkOpaque(chunk, index) (((chunk)->data->occupancy[(index) >> 6] >> ((index) & 63)) & 1)
+#ifdef CHUNK_MORTON_ORDER
+// Nonzero if any voxel of the z row starting at index is opaque. Each occupancy word is a 4^3 block, of which a z row takes bits 0x303 << (x, y offset)
+uint64_t chunkOpaqueRowMorton(Chunk *chunk, unsigned int index) {
+    uint64_t row = 0;
+    for (unsigned int z = 0; z < CHUNK_SIZE; z += 4) {
+        unsigned int block_index = index | mortonSpread(z);
+        row |= (chunk->data->occupancy[block_index >> 6] >> (block_index & 63)) & 0x303;
+    }
+    return row;
+}
+#define chunkOpaqueRow(chunk, index) chunkOpaqueRowMorton(chunk, index)
+#else
+// The CHUNK_SIZE bits of a z row starting at index, z rows never straddle a word since CHUNK_SIZE divides 64
+#define chunkOpaqueRow(chunk, index) (((chunk)->data->occupancy[(index) >> 6] >> ((index) & 63)) & ((1ULL << CHUNK_SIZE) - 1))
+#endif
+
+#define getChunkVoxel(chunk, index) getStorageVoxel(&(chunk)->data->storage, (index))
+
+// All voxel writes should go through here to keep the occupancy mask in sync. The LOD pyramid needs a buildChunkLODOccupancy afterwards
+void setChunkVoxel(Chunk *chunk, int index, Voxel voxel) {
+    setStorageVoxel(&chunk->data->storage, index, voxel);
+    uint64_t bit = 1ULL << (index & 63);
+    if (opaqueVoxel(voxel)) { chunk->data->occupancy[index >> 6] |= bit; }
+    else { chunk->data->occupancy[index >> 6] &= ~bit; }
+}
+
+// Bit of cell (x, y, z) of a coarse level, in cells of that level
+#define getLODCellBit(level, x, y, z) (lodOccupancyOffset(level) + ((x) * (CHUNK_SIZE >> (level)) + (y)) * (CHUNK_SIZE >> (level)) + (z))
+#define getLODBit(bits, bit) (((bits)[(bit) >> 6] >> ((bit) & 63)) & 1)
+
+// Cell occupancy at any level, level 0 is the voxel occupancy itself
+uint chunkCellAny(Chunk *chunk, int level, int x, int y, int z) {
+    if (level == 0) { return chunkOpaque(chunk, getVoxelIndex(x, y, z)); }
+    // Tree chunks read the cell from the tree level of that size. Air is the only block that is not opaque, so non-empty is occupied
+    if (chunk->data->storage.mode == STORAGE_TREE) { return treeCellAny(&chunk->data->storage.tree, x << level, y << level, z << level, 1 << level); }
+    return getLODBit(chunk->data->lod_any, getLODCellBit(level, x, y, z));
+}
+
+uint chunkCellFull(Chunk *chunk, int level, int x, int y, int z) {
+    if (level == 0) { return chunkOpaque(chunk, getVoxelIndex(x, y, z)); }
+    return getLODBit(chunk->data->lod_full, getLODCellBit(level, x, y, z));
+}
+
+// Any / full of the 2^3 cells one level down that make up cell (x, y, z)
+void getLODChildOccupancy(Chunk *chunk, int level, int x, int y, int z, uint *any, uint *full) {
+#ifdef CHUNK_MORTON_ORDER
+    if (level == 1) {
+        // The 8 voxels of a level 1 cell are a single byte of the occupancy mask
+        unsigned int first = mortonEncode(x, y, z) << 3;
+        uint64_t voxels = (chunk->data->occupancy[first >> 6] >> (first & 63)) & 0xFF;
+        *any = voxels != 0;
+        *full = voxels == 0xFF;
+        return;
+    }
+#endif
+
+    *any = 0;
+    *full = 1;
+    for (int child = 0; child < 8; child++) {
+        int cx = x * 2 + (child >> 2), cy = y * 2 + ((child >> 1) & 1), cz = z * 2 + (child & 1);
+        *any |= chunkCellAny(chunk, level - 1, cx, cy, cz);
+        *full &= chunkCellFull(chunk, level - 1, cx, cy, cz);
+    }
+}
+
+// Each level is built from the one below it, a cell being the 2^3 cells under it
+void buildChunkLODOccupancy(Chunk *chunk) {
+    memset(chunk->data->lod_any, 0, sizeof(chunk->data->lod_any));
+    memset(chunk->data->lod_full, 0, sizeof(chunk->data->lod_full));
+
+    for (int level = 1; level <= CHUNK_MAX_LOD; level++) {
+        int cells = CHUNK_SIZE >> level;
+        for (int x = 0; x < cells; x++) {
+            for (int y = 0; y < cells; y++) {
+                for (int z = 0; z < cells; z++) {
+                    uint any, full;
+                    getLODChildOccupancy(chunk, level, x, y, z, &any, &full);
+
+                    int bit = getLODCellBit(level, x, y, z);
+                    chunk->data->lod_any[bit >> 6] |= (uint64_t) any << (bit & 63);
+                    chunk->data->lod_full[bit >> 6] |= (uint64_t) full << (bit & 63);
+                }
+            }
+        }
+    }
+}
+
+// Block used to colour a coarse cell, the highest opaque voxel in it so surfaces keep their top block
+Voxel getLODCellVoxel(Chunk *chunk, int x, int y, int z, int lod_scale) {
+    for (int cy = y + lod_scale - 1; cy >= y; cy--) {
+        for (int cx = x; cx < x + lod_scale; cx++) {
+            for (int cz = z; cz < z + lod_scale; cz++) {
+                int voxel_index = getVoxelIndex(cx, cy, cz);
+                if (chunkOpaque(chunk, voxel_index)) { return getChunkVoxel(chunk, voxel_index); }
+            }
+        }
+    }
+    return BLOCK_AIR;
+}
+
+int chunkIsEmpty(Chunk *chunk) {
+    for (int i = 0; i < CHUNK_OCCUPANCY_WORDS; i++) {
+        if (chunk->data->occupancy[i] != 0) { return 0; }
+    }
+    return 1;
+}
+
+int chunkIsFull(Chunk *chunk) {
+    for (int i = 0; i < CHUNK_OCCUPANCY_WORDS; i++) {
+        if (chunk->data->occupancy[i] != ~0ULL) { return 0; }
+    }
+    return 1;
+}
+
+// Decodes the x slice of a chunk into slice[y * CHUNK_SIZE + z] from its column runs,
+// so the mesher does one run walk per column instead of one per voxel on RLE chunks
+void decodeChunkSlice(Chunk *chunk, int x, Voxel *slice) {
+    for (int z = 0; z < CHUNK_SIZE; z++) {
+        ColumnRunIterator it = beginColumnRuns(&chunk->data->storage, x * CHUNK_SIZE + z);
+        while (nextColumnRun(&it)) {
+            for (unsigned int y = it.y; y < it.y + it.length; y++) { slice[y * CHUNK_SIZE + z] = it.voxel; }
+        }
+    }
+}
+
+// Whether a coordinate on the LOD grid touches the chunk border
+#define onChunkBorder(coord, lod_scale) ((coord) == 0 || (coord) == CHUNK_SIZE - (lod_scale))
+
+// Height bands with a little jitter so the borders between them are not flat
+Voxel getTerrainBlock(int x, int y, int z) {
+    int real_y = y + (int) (hashPosition(x, y, z) % 3) - 1;
+    if (real_y < 16) { return BLOCK_STONE; }
+    if (real_y < 32) { return BLOCK_DIRT; }
+    if (real_y < 48) { return BLOCK_GRASS; }
+    return BLOCK_SNOW;
+}
+
+#define TERRAIN_NOISE_SCALE 64. // Voxels per noise unit, independent of CHUNK_SIZE so both sizes generate the same terrain
+
+void generateNewChunk(Chunk *chunk, int world_height, int seed) {
+    vec2 seed_offset;
+    getSeedOffset(seed, seed_offset);
+
     for (int x = 0; x < CHUNK_SIZE; x++) {
         for (int z = 0; z < CHUNK_SIZE; z++) {
             vec2 column_pos = {x + CHUNK_SIZE * chunk->chunk_pos[0], z + CHUNK_SIZE * chunk->chunk_pos[2]};
-            glm_vec2_divs(column_pos, CHUNK_SIZE * 4, column_pos);
+            glm_vec2_divs(column_pos, TERRAIN_NOISE_SCALE, column_pos);
+            glm_vec2_add(column_pos, seed_offset, column_pos);
             // Perlin noise
             int cut_off = (int) (layered2DNoise(column_pos, 4, 0.25, 2) * world_height * CHUNK_SIZE * 0.5) - chunk->chunk_pos[1] * CHUNK_SIZE + (world_height / 2) * CHUNK_SIZE;
 
             for (int y = 0; y < CHUNK_SIZE; y++) {
                 int voxel_index = getVoxelIndex(x, y, z);
-                if (y < cut_off) { chunk->voxels[voxel_index] = OCCUPIED; }
-                else { chunk->voxels[voxel_index] = EMPTY; }
-                //chunk->voxels[voxel_index] = OCCUPIED;
+                // Storage starts as air
+                if (y < cut_off) { setChunkVoxel(chunk, voxel_index, getTerrainBlock(x + CHUNK_SIZE * chunk->chunk_pos[0], y + CHUNK_SIZE * chunk->chunk_pos[1], z + CHUNK_SIZE * chunk->chunk_pos[2])); }
+                //setChunkVoxel(chunk, voxel_index, BLOCK_STONE);
             }
         }
     }
 }
 
-uint opaqueVoxel(Voxel voxel) {
-    return voxel == OCCUPIED;
-}
-
-// Issues:
-// - Doesnt account for scaling up, aka lod 1 -> lod 2 can see a voxel when it is not rendered - Shouldnt be a problem though since player will never see this face
-// Still strugling with some down-scaling issues (see rd 1, wh 1, 44, -33), only happens in -x downscaling direction (+x quads)
-void checkVoxelNeighbours(Chunk* chunk, Voxel (*getVoxel)(ivec3 pos), int x, int y, int z, uint voxel_index, ivec3 voxel_pos, uint *neighbours) {
-    if (chunk->lod_scale == 0) {
-        if (x + chunk->lod_scale < CHUNK_SIZE) { neighbours[0] = opaqueVoxel(chunk->voxels[getOffsetIndex(voxel_index, chunk->lod_scale, 0, 0)]); }
-        else                                   { neighbours[0] = opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos,        chunk->lod_scale, 0, 0))); }
-        if (x - chunk->lod_scale >= 0)         { neighbours[1] = opaqueVoxel(chunk->voxels[getOffsetIndex(voxel_index,-chunk->lod_scale, 0, 0)]); }
-        else                                   { neighbours[1] = opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos,       -chunk->lod_scale, 0, 0))); }
-        if (y + chunk->lod_scale < CHUNK_SIZE) { neighbours[2] = opaqueVoxel(chunk->voxels[getOffsetIndex(voxel_index, 0, chunk->lod_scale, 0)]); }
-        else                                   { neighbours[2] = opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos,        0, chunk->lod_scale, 0))); }
-        if (y - chunk->lod_scale >= 0)         { neighbours[3] = opaqueVoxel(chunk->voxels[getOffsetIndex(voxel_index, 0,-chunk->lod_scale, 0)]); }
-        else                                   { neighbours[3] = opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos,        0,-chunk->lod_scale, 0))); }
-        if (z + chunk->lod_scale < CHUNK_SIZE) { neighbours[4] = opaqueVoxel(chunk->voxels[getOffsetIndex(voxel_index, 0, 0, chunk->lod_scale)]); }
-        else                                   { neighbours[4] = opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos,        0, 0, chunk->lod_scale))); }
-        if (z - chunk->lod_scale >= 0)         { neighbours[5] = opaqueVoxel(chunk->voxels[getOffsetIndex(voxel_index, 0, 0,-chunk->lod_scale)]); }
-        else                                   { neighbours[5] = opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos,        0, 0,-chunk->lod_scale))); }
-    } else {
-        // To account for scaling down, we sample 4 times per face.
-        // We dont need to account for upscaling, since players will never see those faces
-        int next_lod = chunk->lod_scale / 2;
-
-        if (x + chunk->lod_scale < CHUNK_SIZE) { neighbours[0] = opaqueVoxel(chunk->voxels[getOffsetIndex(voxel_index, chunk->lod_scale, 0, 0)]); }
-        else { 
-            neighbours[0] = opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, chunk->lod_scale, 0,        0       ))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, chunk->lod_scale, next_lod, 0       ))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, chunk->lod_scale, 0,        next_lod))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, chunk->lod_scale, next_lod, next_lod))); 
-        }
-        if (x - chunk->lod_scale >= 0)         { neighbours[1] = opaqueVoxel(chunk->voxels[getOffsetIndex(voxel_index,-chunk->lod_scale, 0, 0)]); }
-        else { 
-            neighbours[1] = opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos,-chunk->lod_scale, 0,        0       ))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos,-chunk->lod_scale, next_lod, 0       ))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos,-chunk->lod_scale, 0,        next_lod))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos,-chunk->lod_scale, next_lod, next_lod))); 
-        }
-        if (y + chunk->lod_scale < CHUNK_SIZE) { neighbours[2] = opaqueVoxel(chunk->voxels[getOffsetIndex(voxel_index, 0, chunk->lod_scale, 0)]); }
-        else { 
-            neighbours[2] = opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, 0,        chunk->lod_scale, 0       ))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, next_lod, chunk->lod_scale, 0       ))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, 0,        chunk->lod_scale, next_lod))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, next_lod, chunk->lod_scale, next_lod))); 
-        }
-        if (y - chunk->lod_scale >= 0)         { neighbours[3] = opaqueVoxel(chunk->voxels[getOffsetIndex(voxel_index, 0,-chunk->lod_scale, 0)]); }
-        else { 
-            neighbours[3] = opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, 0,       -chunk->lod_scale, 0       ))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, next_lod,-chunk->lod_scale, 0       ))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, 0,       -chunk->lod_scale, next_lod))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, next_lod,-chunk->lod_scale, next_lod))); 
-        }
-        if (z + chunk->lod_scale < CHUNK_SIZE) { neighbours[4] = opaqueVoxel(chunk->voxels[getOffsetIndex(voxel_index, 0, 0, chunk->lod_scale)]); }
-        else { 
-            neighbours[4] = opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, 0,        0       , chunk->lod_scale))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, next_lod, 0       , chunk->lod_scale))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, 0,        next_lod, chunk->lod_scale))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, next_lod, next_lod, chunk->lod_scale))); 
-        }
-        if (z - chunk->lod_scale >= 0)         { neighbours[5] = opaqueVoxel(chunk->voxels[getOffsetIndex(voxel_index, 0, 0,-chunk->lod_scale)]); }
-        else { 
-            neighbours[5] = opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, 0,        0       ,-chunk->lod_scale))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, next_lod, 0       ,-chunk->lod_scale))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, 0,        next_lod,-chunk->lod_scale))) &&
-                            opaqueVoxel(getVoxel(getOffsetIvec3(voxel_pos, next_lod, next_lod,-chunk->lod_scale))); 
+const int face_offsets[6][3] = {
+    { 1, 0, 0}, {-1, 0, 0},
+    { 0, 1, 0}, { 0,-1, 0},
+    { 0, 0, 1}, { 0, 0,-1}
+};
+
+// Works on cells of the chunk's LOD level, (x, y, z) being the cell corner in voxels.
+// Inside the chunk a face is hidden by any occupied cell, so each LOD is a closed surface of its own cells.
+// Across chunk borders it is only hidden by a full cell, whatever LOD the neighbour renders at that region stays solid.
+void checkVoxelNeighbours(Chunk* chunk, OpaqueFunction isOpaque, int x, int y, int z, ivec3 voxel_pos, uint *neighbours) {
+    int cells = CHUNK_SIZE / chunk->lod_scale;
+    int cell_x = x / chunk->lod_scale, cell_y = y / chunk->lod_scale, cell_z = z / chunk->lod_scale;
+
+    for (int face = 0; face < 6; face++) {
+        int nx = cell_x + face_offsets[face][0], ny = cell_y + face_offsets[face][1], nz = cell_z + face_offsets[face][2];
+
+        if (nx >= 0 && nx < cells && ny >= 0 && ny < cells && nz >= 0 && nz < cells) { neighbours[face] = chunkCellAny(chunk, chunk->lod, nx, ny, nz); }
+        else {
+            neighbours[face] = isOpaque(getOffsetIvec3(voxel_pos, face_offsets[face][0] * chunk->lod_scale, face_offsets[face][1] * chunk->lod_scale, face_offsets[face][2] * chunk->lod_scale), chunk->lod);
         }
     }
 }
 
-void createChunkMesh(Chunk *chunk, Voxel (*getVoxel)(ivec3 pos)) {
+void createChunkMesh(Chunk *chunk, OpaqueFunction isOpaque, MeshSink mesh_sink) {
+    traceBeginChunk("createChunkMesh", chunk->chunk_pos, chunk->lod);
+
+    // All air, nothing to mesh and no buffer needed
+    if (chunkIsEmpty(chunk)) {
+        chunk->buffer_bundle = (SSBOBundle) { .SSBO = 0, .length = 0, .size = 0 };
+        chunk->meshed = 1;
+        traceEnd("createChunkMesh");
+        return;
+    }
+
     Vector voxel_data = vectorInit(sizeof(VoxelData), VALS_PER_VOXEL);
-    int voxels_per_lod_block = (chunk->lod_scale * chunk->lod_scale * chunk->lod_scale);
+    vectorTrackMemory(&voxel_data, MEMORY_MESHER_STAGING);
+    int chunk_full = chunkIsFull(chunk);
+    int decode_slices = chunk->data->storage.mode == STORAGE_RLE && chunk->lod == 0;
+    Voxel slice[CHUNK_SIZE * CHUNK_SIZE];
 
     for (int x = 0; x < CHUNK_SIZE; x += chunk->lod_scale) {
+        if (decode_slices) { decodeChunkSlice(chunk, x, slice); }
+
         for (int y = 0; y < CHUNK_SIZE; y += chunk->lod_scale) {
-            for (int z = 0; z < CHUNK_SIZE; z += chunk->lod_scale) {
-                int voxel_index = getVoxelIndex(x, y, z);
-                
-                if (!opaqueVoxel(chunk->voxels[voxel_index])) { continue; }
+            if (chunk->lod == 0 && !chunkOpaqueRow(chunk, getVoxelIndex(x, y, 0))) { continue; } // Whole z row is empty
+            // In a full chunk only border voxels can have a visible face, so interior rows jump straight to the last z
+            int z_step = chunk_full && !onChunkBorder(x, chunk->lod_scale) && !onChunkBorder(y, chunk->lod_scale) ? CHUNK_SIZE - chunk->lod_scale : chunk->lod_scale;
+
+            for (int z = 0; z < CHUNK_SIZE; z += z_step) {
+                if (!chunkCellAny(chunk, chunk->lod, x / chunk->lod_scale, y / chunk->lod_scale, z / chunk->lod_scale)) { continue; }
 
                 ivec3 voxel_pos = getVoxelPos(x, y, z, chunk->chunk_pos);
                 
                 uint neighbours[6];
-                checkVoxelNeighbours(chunk, getVoxel, x, y, z, voxel_index, voxel_pos, neighbours);
+                checkVoxelNeighbours(chunk, isOpaque, x, y, z, voxel_pos, neighbours);
                 
                 if (neighbours[0] &&
                     neighbours[1] &&
@@ -173,17 +378,11 @@ void createChunkMesh(Chunk *chunk, Voxel (*getVoxel)(ivec3 pos)) {
                     continue;
                 } 
                 
-                ivec3 voxel_color; // 4 bits per channel (0 - 16);
-                int real_y = y + chunk->chunk_pos[1] * CHUNK_SIZE + (int) ((((float) rand() / RAND_MAX) - 0.5) * 4);
-                if (real_y < 16) {
-                    glm_ivec3_copy((ivec3) {8, 8, 8}, voxel_color);
-                } else if (real_y < 32) {
-                    glm_ivec3_copy((ivec3) {9, 7, 5}, voxel_color);
-                } else if (real_y < 48) {
-                    glm_ivec3_copy((ivec3) {7, 12, 5}, voxel_color);
-                } else {
-                    glm_ivec3_copy((ivec3) {15, 15, 15}, voxel_color);
-                }
+                Voxel voxel;
+                if (chunk->lod > 0) { voxel = getLODCellVoxel(chunk, x, y, z, chunk->lod_scale); }
+                else if (decode_slices) { voxel = slice[y * CHUNK_SIZE + z]; }
+                else { voxel = getChunkVoxel(chunk, getVoxelIndex(x, y, z)); }
+                const int *voxel_color = materials[voxel].color;
 
                 // ivec3 voxel_color = {x, y, z};
                 // glm_ivec3_adds(voxel_color, chunk->lod_scale / 2, voxel_color);
@@ -198,28 +397,51 @@ void createChunkMesh(Chunk *chunk, Voxel (*getVoxel)(ivec3 pos)) {
         }
     }
 
-    chunk->buffer_bundle = createBuffers(&voxel_data);
+    incrementCounter(COUNTER_FACES_EMITTED, voxel_data.size);
+    // Fully hidden chunks (e.g. buried solid ones) skip the sink so they never get a GL buffer
+    if (voxel_data.size == 0) { chunk->buffer_bundle = (SSBOBundle) { .SSBO = 0, .length = 0, .size = 0 }; }
+    else { chunk->buffer_bundle = mesh_sink(&voxel_data); }
+    chunk->meshed = 1;
 
     freeVector(&voxel_data);
+    traceEnd("createChunkMesh");
 }
 
-void updateChunkLOD(Chunk *chunk, int lod, Voxel (*getVoxel)(ivec3 pos)) {
+void updateChunkLOD(Chunk *chunk, int lod, OpaqueFunction isOpaque, MeshSink mesh_sink) {
+    traceBeginChunk("updateChunkLOD", chunk->chunk_pos, lod);
     chunk->lod = lod;
     chunk->lod_scale = pow(2, lod);
+    if (!chunk->meshed) { traceEnd("updateChunkLOD"); return; } // Still queued, will be meshed at the new LOD
 
     deleteSSBOBundle(&chunk->buffer_bundle);
-    createChunkMesh(chunk, getVoxel); // Remesh
+    createChunkMesh(chunk, isOpaque, mesh_sink); // Remesh
+    traceEnd("updateChunkLOD");
 }
 
-Chunk *createChunk(ivec3 chunk_pos, int verbose, int world_height, int lod) {
-    Chunk *chunk = malloc(sizeof(Chunk));
-    if (chunk == NULL) { return NULL; }
-
+// Generates the chunk's voxels at chunk_pos into its existing ChunkData, leaving it unmeshed
+int generateChunkData(Chunk *chunk, ivec3 chunk_pos, int world_height, int lod, int seed) {
     glm_ivec3_copy(chunk_pos, chunk->chunk_pos);
     chunk->lod = lod;
     chunk->lod_scale = pow(2, lod);
+    chunk->meshed = 0;
+    chunk->buffer_bundle = (SSBOBundle) { .SSBO = 0, .length = 0, .size = 0 };
 
-    generateNewChunk(chunk, world_height);
+    // Starts uniform air, so chunks above the surface never allocate a voxel array. Generation writes flat voxels,
+    // which are converted to the storage mode once, per voxel writes to RLE would re-encode the column every time
+    ChunkStorage *storage = &chunk->data->storage;
+    if (!initStorage(storage, STORAGE_UNIFORM, CHUNK_VOLUME, BLOCK_AIR)) { return 0; }
+    storage->expand_mode = STORAGE_FLAT;
+    memset(chunk->data->occupancy, 0, sizeof(chunk->data->occupancy));
+    generateNewChunk(chunk, world_height, seed);
+    if (!compactStorage(storage)) {
+        // Solid chunks are rarely a single block, the band jitter mixes in the next band at their top or bottom. The mesher
+        // only reads their border voxels, so they are kept as a palette, 1 bit per voxel for two blocks, whatever the mode
+        ChunkStorageMode mode = chunkIsFull(chunk) ? STORAGE_PALETTE : chooseStorageMode(storage, default_storage_mode);
+        if (!convertStorage(storage, mode)) { printf("ERROR: Could not convert chunk storage.\n"); }
+        compactStorage(storage); // Trims tree storage
+    }
+    storage->expand_mode = default_storage_mode;
+    buildChunkLODOccupancy(chunk);
 
     glm_mat4_dup(GLM_MAT4_IDENTITY, chunk->model);
     vec3 chunk_translation;
@@ -228,9 +450,41 @@ Chunk *createChunk(ivec3 chunk_pos, int verbose, int world_height, int lod) {
     chunk_translation[2] = (float) chunk->chunk_pos[2] * CHUNK_SIZE;
     glm_translate(chunk->model, chunk_translation);
 
+    return 1;
+}
+
+// Builds the chunk in place. Returns 0 if out of memory
+int initChunk(Chunk *chunk, ivec3 chunk_pos, int verbose, int world_height, int lod, int seed) {
+    chunk->data = poolAlloc(&chunk_data_pool);
+    if (chunk->data == NULL) { return 0; }
+    if (!generateChunkData(chunk, chunk_pos, world_height, lod, seed)) { poolRelease(&chunk_data_pool, chunk->data); chunk->data = NULL; return 0; }
+
     if (verbose) { printf("Created a chunk at (%d, %d, %d).\n", chunk->chunk_pos[0], chunk->chunk_pos[1], chunk->chunk_pos[2]); }
 
+    return 1;
+}
+
+// Allocates the chunk from chunk_pool and builds it there, NULL if out of memory
+Chunk *createChunk(ivec3 chunk_pos, int verbose, int world_height, int lod, int seed) {
+    Chunk *chunk = poolAlloc(&chunk_pool);
+    if (chunk == NULL) { return NULL; }
+    if (!initChunk(chunk, chunk_pos, verbose, world_height, lod, seed)) { poolRelease(&chunk_pool, chunk); return NULL; }
+
     return chunk;
 }
 
+// Reuses a loaded chunk for another position: drops its mesh and voxels but keeps the Chunk and ChunkData allocations
+int recycleChunk(Chunk *chunk, ivec3 chunk_pos, int world_height, int lod, int seed) {
+    deleteSSBOBundle(&chunk->buffer_bundle);
+    freeStorage(&chunk->data->storage);
+    return generateChunkData(chunk, chunk_pos, world_height, lod, seed);
+}
+
+void freeChunk(Chunk *chunk) {
+    deleteSSBOBundle(&chunk->buffer_bundle);
+    freeStorage(&chunk->data->storage);
+    poolRelease(&chunk_data_pool, chunk->data);
+    poolRelease(&chunk_pool, chunk);
+}
+
 #endif
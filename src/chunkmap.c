@@ -0,0 +1,138 @@
+#ifndef CHUNKMAP
+#define CHUNKMAP
+
+#include "memory.c"
+
+#include "cglm/cglm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+// Open addressing (linear probing) hash map from an ivec3 grid position to a slot in a vector.
+// The world keys its regions by region position with it, see region.c.
+// Erased entries leave tombstones so probe chains stay intact, they are dropped whenever the table is rebuilt.
+
+#define CHUNK_MAP_EMPTY -1
+#define CHUNK_MAP_TOMBSTONE -2
+#define CHUNK_MAP_MIN_CAPACITY 16
+
+typedef struct ChunkMapEntry {
+    ivec3 pos;
+    int slot; // Or CHUNK_MAP_EMPTY / CHUNK_MAP_TOMBSTONE
+} ChunkMapEntry;
+
+typedef struct ChunkMap {
+    ChunkMapEntry *entries;
+    size_t capacity; // Power of 2
+    size_t count;
+    size_t tombstones;
+} ChunkMap;
+
+uint32_t hashChunkPos(ivec3 pos) {
+    uint32_t hash = (uint32_t) pos[0] * 0x9E3779B1u + (uint32_t) pos[1] * 0x85EBCA77u + (uint32_t) pos[2] * 0xC2B2AE3Du;
+    return hash ^ (hash >> 15);
+}
+
+int initChunkMapEntries(ChunkMap *map, size_t capacity) {
+    map->entries = malloc(capacity * sizeof(ChunkMapEntry));
+    if (map->entries == NULL) { return 0; }
+
+    for (size_t i = 0; i < capacity; i++) { map->entries[i].slot = CHUNK_MAP_EMPTY; }
+    map->capacity = capacity;
+    map->count = 0;
+    map->tombstones = 0;
+    trackMemory(MEMORY_CHUNK_INDEX, capacity * sizeof(ChunkMapEntry));
+    return 1;
+}
+
+// Sized so `expected` chunks fit without rehashing
+ChunkMap createChunkMap(size_t expected) {
+    ChunkMap map = { .entries = NULL, .capacity = 0, .count = 0, .tombstones = 0 };
+    size_t capacity = CHUNK_MAP_MIN_CAPACITY;
+    while (capacity < expected * 2) { capacity *= 2; }
+
+    if (!initChunkMapEntries(&map, capacity)) { printf("ERROR: Could not allocate chunk map.\n"); }
+    return map;
+}
+
+void freeChunkMap(ChunkMap *map) {
+    trackMemory(MEMORY_CHUNK_INDEX, -(long long) (map->capacity * sizeof(ChunkMapEntry)));
+    free(map->entries);
+    map->entries = NULL;
+    map->capacity = map->count = map->tombstones = 0;
+}
+
+// Index of the entry for pos, or of the empty entry ending its probe chain
+size_t findChunkMapEntry(ChunkMap *map, ivec3 pos) {
+    size_t mask = map->capacity - 1;
+    size_t i = hashChunkPos(pos) & mask;
+    while (map->entries[i].slot != CHUNK_MAP_EMPTY) {
+        if (map->entries[i].slot != CHUNK_MAP_TOMBSTONE && glm_ivec3_eqv(map->entries[i].pos, pos)) { return i; }
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Returns the slot of the chunk at pos, or -1 if it is not loaded
+int chunkMapGet(ChunkMap *map, ivec3 pos) {
+    if (map->capacity == 0) { return -1; }
+    return map->entries[findChunkMapEntry(map, pos)].slot; // CHUNK_MAP_EMPTY is -1
+}
+
+int insertChunkMapEntry(ChunkMap *map, ivec3 pos, int slot);
+
+// Rebuilds into a table of the given capacity, dropping tombstones
+int rehashChunkMap(ChunkMap *map, size_t capacity) {
+    ChunkMap old = *map;
+    if (!initChunkMapEntries(map, capacity)) { *map = old; return 0; }
+
+    for (size_t i = 0; i < old.capacity; i++) {
+        if (old.entries[i].slot >= 0) { insertChunkMapEntry(map, old.entries[i].pos, old.entries[i].slot); }
+    }
+    freeChunkMap(&old);
+    return 1;
+}
+
+int insertChunkMapEntry(ChunkMap *map, ivec3 pos, int slot) {
+    size_t mask = map->capacity - 1;
+    size_t i = hashChunkPos(pos) & mask;
+    long long first_tombstone = -1;
+
+    while (map->entries[i].slot != CHUNK_MAP_EMPTY) {
+        if (map->entries[i].slot == CHUNK_MAP_TOMBSTONE) { if (first_tombstone < 0) { first_tombstone = i; } }
+        else if (glm_ivec3_eqv(map->entries[i].pos, pos)) { map->entries[i].slot = slot; return 1; } // Update
+        i = (i + 1) & mask;
+    }
+
+    if (first_tombstone >= 0) { i = first_tombstone; map->tombstones--; }
+    glm_ivec3_copy(pos, map->entries[i].pos);
+    map->entries[i].slot = slot;
+    map->count++;
+    return 1;
+}
+
+// Adds pos, or points it at a new slot if it is already there. Keeps the load (including tombstones) at or under 1/2
+int chunkMapInsert(ChunkMap *map, ivec3 pos, int slot) {
+    if ((map->count + map->tombstones + 1) * 2 > map->capacity) {
+        size_t capacity = map->capacity < CHUNK_MAP_MIN_CAPACITY ? CHUNK_MAP_MIN_CAPACITY : map->capacity;
+        while ((map->count + 1) * 2 > capacity) { capacity *= 2; }
+        if (!rehashChunkMap(map, capacity)) { printf("ERROR: Could not grow chunk map.\n"); return 0; }
+    }
+    return insertChunkMapEntry(map, pos, slot);
+}
+
+// Returns 0 if pos was not in the map
+int chunkMapErase(ChunkMap *map, ivec3 pos) {
+    if (map->capacity == 0) { return 0; }
+
+    size_t i = findChunkMapEntry(map, pos);
+    if (map->entries[i].slot == CHUNK_MAP_EMPTY) { return 0; }
+
+    map->entries[i].slot = CHUNK_MAP_TOMBSTONE;
+    map->count--;
+    map->tombstones++;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef COUNTERS
+#define COUNTERS
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Global engine counters. Totals only ever increase, and beginCounterFrame / endCounterFrame
+// turn them into per frame (or per benchmark pass) deltas.
+
+typedef enum Counter {
+    COUNTER_DRAW_CALLS,
+    COUNTER_PROGRAM_BINDS,
+    COUNTER_UNIFORM_APPLIES,
+    COUNTER_SSBO_UPLOADS,
+    COUNTER_SSBO_BYTES,
+    COUNTER_FACES_EMITTED,
+    COUNTER_VECTOR_REALLOCS,
+    COUNTER_POOL_SLABS,
+    COUNTER_COUNT
+} Counter;
+
+const char *counter_names[COUNTER_COUNT] = {
+    "draws",
+    "programs",
+    "uniforms",
+    "uploads",
+    "upload_bytes",
+    "faces",
+    "reallocs",
+    "slabs"
+};
+
+typedef struct Counters {
+    unsigned long long totals[COUNTER_COUNT];
+    unsigned long long frame_start[COUNTER_COUNT];
+    unsigned long long deltas[COUNTER_COUNT]; // Last completed frame
+} Counters;
+
+Counters counters;
+
+#define incrementCounter(counter, amount) (counters.totals[counter] += (amount))
+
+void beginCounterFrame() {
+    for (int i = 0; i < COUNTER_COUNT; i++) { counters.frame_start[i] = counters.totals[i]; }
+}
+
+void endCounterFrame() {
+    for (int i = 0; i < COUNTER_COUNT; i++) { counters.deltas[i] = counters.totals[i] - counters.frame_start[i]; }
+}
+
+// Writes the last frame's deltas, e.g. "draws 1024 programs 1030 ..."
+void getCounterString(char *buffer, size_t buffer_size) {
+    size_t written = 0;
+    for (int i = 0; i < COUNTER_COUNT && written < buffer_size; i++) {
+        written += snprintf(buffer + written, buffer_size - written, "%s%s %llu", i == 0 ? "" : " ", counter_names[i], counters.deltas[i]);
+    }
+}
+
+#endif
@@ -9,6 +9,9 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include "memory.c"
+#include "counters.c"
+
 #define OPENGL_N_SIZE 4 // sizeof(float) for the GPU
 
 typedef struct {
@@ -31,6 +34,7 @@ typedef struct {
 typedef struct {
     unsigned int SSBO;
     unsigned int length;
+    size_t size; // Bytes allocated on the GPU
 } SSBOBundle;
 
 typedef void (*UniformFunction)(unsigned int programID); 
@@ -206,6 +210,7 @@ void updateBuffer(GLenum buffer_type, unsigned int buffer_id, void *data, size_t
 }
 
 void applyUniforms(ProgramBundle *program) {
+    incrementCounter(COUNTER_UNIFORM_APPLIES, 1);
     for (unsigned int i = 0; i < program->uniforms.size; i++){
         program->uniforms.values[i].func(program->uniforms.values[i].location);
     }
@@ -267,7 +272,11 @@ void applyUniformBufferBundle(UniformBufferBundle *bundle) {
 }
 
 void deleteSSBOBundle(SSBOBundle *bundle) {
+    if (bundle->SSBO == 0) { return; } // Never uploaded (e.g. headless mesh sinks)
     glDeleteBuffers(1, &bundle->SSBO);
+    bundle->SSBO = 0;
+    trackMemory(MEMORY_GPU_SSBO, -(long long) bundle->size);
+    bundle->size = 0;
 }
 
 SSBOBundle createSSBOBundle(void *values, size_t data_size, unsigned int length, int verbose) {
@@ -283,6 +292,10 @@ SSBOBundle createSSBOBundle(void *values, size_t data_size, unsigned int length,
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
     bundle.length = length;
+    bundle.size = data_size;
+    trackMemory(MEMORY_GPU_SSBO, data_size);
+    incrementCounter(COUNTER_SSBO_UPLOADS, 1);
+    incrementCounter(COUNTER_SSBO_BYTES, data_size);
 
     return bundle;
 }
@@ -291,17 +304,70 @@ void bindSBBOBundle(SSBOBundle *bundle, unsigned int bind_point) {
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bind_point, bundle->SSBO);
 }
 
+// Double buffered GL_TIME_ELAPSED query. Results are read a frame later and only once available,
+// so timing a pass never stalls the pipeline. If the older query is still in flight that frame is skipped.
+#define GPU_TIMER_BUFFERS 2
+
+typedef struct GPUTimer {
+    unsigned int queries[GPU_TIMER_BUFFERS];
+    int pending[GPU_TIMER_BUFFERS];
+    unsigned int current;
+    int active;
+    double time; // Seconds, most recent result
+} GPUTimer;
+
+GPUTimer createGPUTimer() {
+    GPUTimer timer = {0};
+    glGenQueries(GPU_TIMER_BUFFERS, timer.queries);
+    return timer;
+}
+
+void collectGPUTimer(GPUTimer *timer, unsigned int buffer) {
+    if (!timer->pending[buffer]) { return; }
+
+    int available = 0;
+    glGetQueryObjectiv(timer->queries[buffer], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) { return; }
+
+    GLuint64 elapsed;
+    glGetQueryObjectui64v(timer->queries[buffer], GL_QUERY_RESULT, &elapsed);
+    timer->time = elapsed / 1.0e9;
+    timer->pending[buffer] = 0;
+}
+
+void beginGPUTimer(GPUTimer *timer) {
+    collectGPUTimer(timer, timer->current);
+    timer->active = !timer->pending[timer->current];
+    if (timer->active) { glBeginQuery(GL_TIME_ELAPSED, timer->queries[timer->current]); }
+}
+
+void endGPUTimer(GPUTimer *timer) {
+    if (timer->active) {
+        glEndQuery(GL_TIME_ELAPSED);
+        timer->pending[timer->current] = 1;
+        timer->active = 0;
+    }
+    timer->current = (timer->current + 1) % GPU_TIMER_BUFFERS;
+    collectGPUTimer(timer, timer->current);
+}
+
+void freeGPUTimer(GPUTimer *timer) {
+    glDeleteQueries(GPU_TIMER_BUFFERS, timer->queries);
+}
+
 void clearWindow(GLFWwindow *window) {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
 void render(GLFWwindow *window, ProgramBundle *program, VertexBufferBundle *buffer) {
     glUseProgram(program->programID);
+    incrementCounter(COUNTER_PROGRAM_BINDS, 1);
     applyUniforms(program);
     glBindVertexArray(buffer->VAO);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer->EBO);
 
     glDrawElements(GL_TRIANGLES, buffer->length, GL_UNSIGNED_INT, 0);
+    incrementCounter(COUNTER_DRAW_CALLS, 1);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     glUseProgram(0);
@@ -309,12 +375,14 @@ void render(GLFWwindow *window, ProgramBundle *program, VertexBufferBundle *buff
 
 void renderWithSSBOBundle(GLFWwindow *window, ProgramBundle *program, SSBOBundle *bundle, unsigned int bind_point, unsigned int draw_amount) {
     glUseProgram(program->programID);
+    incrementCounter(COUNTER_PROGRAM_BINDS, 1);
     applyUniforms(program);
 
     glBindVertexArray(empty_vao);
     bindSBBOBundle(bundle, bind_point);
     
     glDrawArrays(GL_TRIANGLES, 0, draw_amount);
+    incrementCounter(COUNTER_DRAW_CALLS, 1);
 
     glBindVertexArray(0);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
@@ -0,0 +1,46 @@
+#ifndef HITCH
+#define HITCH
+
+#include "profiler.c"
+#include "counters.c"
+#include "world.c"
+
+#include <stdio.h>
+
+// Frame time watchdog. Any frame slower than the threshold is logged with its phase breakdown
+// and how much remeshing tickWorld did, so stutters are caught in long unattended runs.
+
+#define DEFAULT_HITCH_THRESHOLD_MS 50.
+
+typedef struct HitchDetector {
+    double threshold; // Seconds
+    unsigned long hitch_count;
+    double worst_time;
+} HitchDetector;
+
+HitchDetector createHitchDetector(double threshold_ms) {
+    return (HitchDetector) { .threshold = threshold_ms / 1000., .hitch_count = 0, .worst_time = 0 };
+}
+
+// Call after profilerEndFrame and endCounterFrame. Faces and bytes come from the frame's counters, so every upload path is included
+void checkForHitch(HitchDetector *detector, World *world) {
+    ProfilerFrame *frame = getProfilerFrame(0);
+    double frame_time = frame->phase_times[PHASE_FRAME];
+    if (frame_time <= detector->threshold) { return; }
+
+    detector->hitch_count++;
+    if (frame_time > detector->worst_time) { detector->worst_time = frame_time; }
+
+    printf("HITCH: frame %lu took %.3fms (threshold %.1fms) |", profiler.frame_count - 1, frame_time * 1000., detector->threshold * 1000.);
+    for (int phase = 1; phase < PHASE_COUNT; phase++) {
+        printf(" %s %.3f", profiler_phase_names[phase], frame->phase_times[phase] * 1000.);
+    }
+    printf(" | streamed %d chunks, evicted %d chunks, remeshed %d chunks, %llu faces, %llu B uploaded\n",
+           world->streamed_chunk_count, world->evicted_chunk_count, world->remeshed_chunk_count, counters.deltas[COUNTER_FACES_EMITTED], counters.deltas[COUNTER_SSBO_BYTES]);
+}
+
+void printHitchReport(HitchDetector *detector) {
+    printf("Hitches over %.1fms: %lu (worst %.3fms)\n", detector->threshold * 1000., detector->hitch_count, detector->worst_time * 1000.);
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef LAYOUT
+#define LAYOUT
+
+#include <stdint.h>
+#include <string.h>
+
+// Order voxels are stored in within a chunk, shared by the chunk arrays, occupancy masks and storage modes.
+//  - Linear (default): x major, then y, then z. z rows are contiguous, ±x neighbours are edge^2 apart.
+//  - Morton (CMake option CHUNK_MORTON_ORDER): bits of x, y and z interleaved (Z-order curve), so every
+//    aligned 2^3, 4^3, ... block is contiguous and neighbours on all axes are usually close. Needs a power of 2 edge.
+
+// Spreads the low 10 bits of v so there are two zero bits between each
+uint32_t mortonSpread(uint32_t v) {
+    v &= 0x3FF;
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v << 8))  & 0x0300F00F;
+    v = (v | (v << 4))  & 0x030C30C3;
+    v = (v | (v << 2))  & 0x09249249;
+    return v;
+}
+
+// Inverse of mortonSpread
+uint32_t mortonCompact(uint32_t v) {
+    v &= 0x09249249;
+    v = (v ^ (v >> 2))  & 0x030C30C3;
+    v = (v ^ (v >> 4))  & 0x0300F00F;
+    v = (v ^ (v >> 8))  & 0x030000FF;
+    v = (v ^ (v >> 16)) & 0x000003FF;
+    return v;
+}
+
+#define mortonEncode(x, y, z) ((mortonSpread(x) << 2) | (mortonSpread(y) << 1) | mortonSpread(z))
+
+#ifdef CHUNK_MORTON_ORDER
+#define VOXEL_LAYOUT_NAME "morton"
+#define encodeVoxelIndex(edge, x, y, z) mortonEncode(x, y, z)
+#define decodeVoxelX(edge, index) mortonCompact((index) >> 2)
+#define decodeVoxelY(edge, index) mortonCompact((index) >> 1)
+#define decodeVoxelZ(edge, index) mortonCompact(index)
+#else
+#define VOXEL_LAYOUT_NAME "linear"
+#define encodeVoxelIndex(edge, x, y, z) ((((x) * (edge)) + (y)) * (edge) + (z))
+#define decodeVoxelX(edge, index) ((index) / ((edge) * (edge)))
+#define decodeVoxelY(edge, index) ((index) / (edge) % (edge))
+#define decodeVoxelZ(edge, index) ((index) % (edge))
+#endif
+
+// Bulk conversion between a plain x major array (e.g. for files or tools) and the compiled layout, src and dst must not overlap
+void voxelsFromLinear(const uint8_t *linear, uint8_t *dst, unsigned int edge) {
+#ifdef CHUNK_MORTON_ORDER
+    unsigned int i = 0;
+    for (unsigned int x = 0; x < edge; x++) {
+        for (unsigned int y = 0; y < edge; y++) {
+            for (unsigned int z = 0; z < edge; z++) { dst[encodeVoxelIndex(edge, x, y, z)] = linear[i++]; }
+        }
+    }
+#else
+    memcpy(dst, linear, edge * edge * edge);
+#endif
+}
+
+void voxelsToLinear(const uint8_t *src, uint8_t *linear, unsigned int edge) {
+#ifdef CHUNK_MORTON_ORDER
+    unsigned int i = 0;
+    for (unsigned int x = 0; x < edge; x++) {
+        for (unsigned int y = 0; y < edge; y++) {
+            for (unsigned int z = 0; z < edge; z++) { linear[i++] = src[encodeVoxelIndex(edge, x, y, z)]; }
+        }
+    }
+#else
+    memcpy(linear, src, edge * edge * edge);
+#endif
+}
+
+#endif
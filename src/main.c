@@ -8,15 +8,18 @@
 
 #include "engine.c"
 #include "player.c"
+#include "replay.c"
+#include "profiler.c"
+#include "hitch.c"
 #include "text.c"
 #include "world.c"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <unistd.h>
 #include <limits.h>
-#include <sys/resource.h>
 
 unsigned int window_width = 1280;
 unsigned int window_height = 800;
@@ -43,7 +46,7 @@ void framebufferSizeCallback(GLFWwindow* window, int width, int height){
 }
 
 unsigned int f_11_down = 0; // Needed for only down press functionality
-void processInput(GLFWwindow *window, float delta_time) {
+void processInput(GLFWwindow *window, float delta_time, int camera_locked) {
     if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) { glfwSetWindowShouldClose(window, 1); }
 
     if (glfwGetKey(window, GLFW_KEY_F11) == GLFW_PRESS) { 
@@ -58,6 +61,7 @@ void processInput(GLFWwindow *window, float delta_time) {
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) { glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);} 
     else { glPolygonMode(GL_FRONT_AND_BACK, GL_FILL); }
 
+    if (camera_locked) { return; }
     cameraMovement(window, delta_time, window_width, window_height);
 }
 
@@ -73,7 +77,61 @@ void lodScaleFunction(unsigned int location){
     glUniform1ui(location, current_chunk_pointer->lod_scale);
 }
 
-int main() {
+#define DEBUG_LINE_HEIGHT 30
+#define PROFILER_GRAPH_ROWS 4
+#define PROFILER_GRAPH_COLUMNS 120
+
+void renderProfilerOverlay(VertexBufferBundle *text_buffer_bundle, ProgramBundle *text_program, float y) {
+    char line[256]; // Must fit PROFILER_GRAPH_COLUMNS + 1
+
+    getMemoryString(line, sizeof(line));
+    renderText(text_buffer_bundle, text_program, line, (vec2) {10, y}, 0.15);
+    y += DEBUG_LINE_HEIGHT;
+
+    getCounterString(line, sizeof(line));
+    renderText(text_buffer_bundle, text_program, line, (vec2) {10, y}, 0.15);
+    y += DEBUG_LINE_HEIGHT;
+
+    getProfilerBreakdown(line, sizeof(line));
+    renderText(text_buffer_bundle, text_program, line, (vec2) {10, y}, 0.15);
+
+    for (unsigned int row = 0; row < PROFILER_GRAPH_ROWS; row++) {
+        y += DEBUG_LINE_HEIGHT;
+        getProfilerGraphRow(line, row, PROFILER_GRAPH_ROWS, PROFILER_GRAPH_COLUMNS);
+        renderText(text_buffer_bundle, text_program, line, (vec2) {10, y}, 0.15);
+    }
+}
+
+void printUsage(char *name) {
+    printf("Usage: %s [--record <file>] [--replay <file>] [--profile-csv <file>] [--trace <file>] [--hitch-ms <ms>] [--fast-start] [--storage <flat|palette|rle|tree>] [--memory-budget <MB>] [--unload-distance <chunks>]\n", name);
+}
+
+int main(int argc, char **argv) {
+    Replay replay = { .mode = REPLAY_OFF };
+    char *record_path = NULL;
+    char *replay_path = NULL;
+    char *profile_csv_path = NULL;
+    char *trace_path = NULL;
+    double hitch_threshold_ms = DEFAULT_HITCH_THRESHOLD_MS;
+    int fast_start = 0;
+    double memory_budget_mb = 0;
+    int unload_distance = 0;
+    for (int i = 1; i < argc; i++) {
+        if      (strcmp(argv[i], "--record") == 0 && i + 1 < argc) { record_path = argv[++i]; }
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) { replay_path = argv[++i]; }
+        else if (strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc) { profile_csv_path = argv[++i]; }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) { trace_path = argv[++i]; }
+        else if (strcmp(argv[i], "--hitch-ms") == 0 && i + 1 < argc) { hitch_threshold_ms = atof(argv[++i]); }
+        else if (strcmp(argv[i], "--fast-start") == 0) { fast_start = 1; }
+        else if (strcmp(argv[i], "--storage") == 0 && i + 1 < argc) { if (!parseStorageMode(argv[++i], &default_storage_mode)) { return -1; } }
+        else if (strcmp(argv[i], "--memory-budget") == 0 && i + 1 < argc) { memory_budget_mb = atof(argv[++i]); }
+        else if (strcmp(argv[i], "--unload-distance") == 0 && i + 1 < argc) { unload_distance = atoi(argv[++i]); }
+        else { printUsage(argv[0]); return -1; }
+    }
+    if (record_path != NULL && replay_path != NULL) { printf("Cannot record and replay at the same time.\n"); return -1; }
+    if (replay_path != NULL && !loadReplay(&replay, replay_path)) { return -1; }
+    if (trace_path != NULL) { startTrace(); }
+
     // Check CWD and CSTD!
     char cwd[PATH_MAX];
     if (getcwd(cwd, sizeof(cwd)) != NULL) { printf("Current working dir: %s\n", cwd); }
@@ -85,31 +143,44 @@ int main() {
     #endif
 
     // Initialise window and glsl
+    beginStartupStage("window_gl");
     GLFWwindow* window = initialiseWindow(window_width, window_height);
     if (window == NULL) { return -1; }
     if (!setupOpenGL(window_width, window_height)) { return -1; }
     glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
-    glfwSetCursorPosCallback(window, cursorPositionCallback);
+    if (replay.mode != REPLAY_PLAYBACK) { glfwSetCursorPosCallback(window, cursorPositionCallback); }
+    endStartupStage("window_gl");
 
     // Initlialise Font Stuff
+    beginStartupStage("font_init");
     initFreeType();
     initFreeTypeFace("./fonts/JetBrainsMonoNerdFont-Regular.ttf", window_width, window_height);
+    endStartupStage("font_init");
+
+    beginStartupStage("font_textures");
     generateFreeTypeTexture();
+    endStartupStage("font_textures");
 
+    beginStartupStage("text_program");
     ProgramBundle text_program = createTextProgram(window_width, window_height);
     VertexBufferBundle text_buffer_bundle = createTextBuffer();
+    endStartupStage("text_program");
 
     // Fetch vertex and fragment source
+    beginStartupStage("shader_read");
     char *chunk_vertex_source = getShaderSource("./src/shaders/basic_vert.glsl");
     if (chunk_vertex_source == NULL) { printf("Error fecthing vertex shader.\n"); return -1; }
 
     char *chunk_fragment_source = getShaderSource("./src/shaders/basic_frag.glsl");
     if (chunk_fragment_source == NULL) { printf("Error fecthing fragment shader.\n"); return -1; }
+    endStartupStage("shader_read");
 
     // Create program bundle
+    beginStartupStage("chunk_program");
     ProgramBundle chunk_program = createProgram(chunk_vertex_source, chunk_fragment_source);
     free(chunk_vertex_source);
     free(chunk_fragment_source);
+    endStartupStage("chunk_program");
 
     // Bind uniforms
     #define UNIFORM_COUNT 2
@@ -126,19 +197,31 @@ int main() {
 
     bindUniformBufferBundle(&chunk_program, &camera_uniform_buffer_bundle, "CamBlock", 0);
 
-    #define RD 3
-    #define WH 4
+    // Counted in chunks but sized in voxels, so every CHUNK_SIZE sees about the same terrain (3 and 4 chunks at 16^3)
+    #define RD max(1, (48 + CHUNK_SIZE / 2) / CHUNK_SIZE)
+    #define WH max(1, 64 / CHUNK_SIZE)
 
     // SOMETHING TERRIBLE HAPPENS AT RD = 16 ????
-    World world = createWorld(RD, WH, (ivec2) {0, 0}, 100);
+    World world = createWorld(RD, WH, (ivec2) {0, 0}, 100, uploadMeshSink);
+    world.memory_budget = memory_budget_mb * 1048576.;
+    if (unload_distance > 0) { world.unload_distance = unload_distance; }
+    populateWorld(&world, fast_start);
+    // Both 0 in fast start mode, generation and meshing then happen during ticks
+    recordStartupStage("generation", world.generation_time);
+    recordStartupStage("meshing", world.meshing_time);
+    double first_frame_start = getPreciseTimeStamp();
     // Chunk* test_chunk = createChunk((ivec3) {0, 0, 0});
     
     // Initlialise Camera
-    initialisePlayerCamera(window_width, window_height, (vec3) {0., WH * 8, 0});
+    initialisePlayerCamera(window_width, window_height, (vec3) {0., WH * CHUNK_SIZE / 2, 0});
 
-    float last = getTimeStamp();
+    if (record_path != NULL && !startRecording(&replay, record_path)) { return -1; }
+
+    HitchDetector hitch_detector = createHitchDetector(hitch_threshold_ms);
+    GPUTimer world_gpu_timer = createGPUTimer();
+    GPUTimer text_gpu_timer = createGPUTimer();
 
-    struct rusage r_usage;
+    float last = getTimeStamp();
 
     int frame_count = 0;
     float last_fps_update = 0;
@@ -157,37 +240,79 @@ int main() {
             last_fps_update = current;
         }
 
+        if (!replayCamera(&replay)) { glfwSetWindowShouldClose(window, 1); break; }
+        profilerBeginFrame();
+        beginCounterFrame();
+
         // Server Code
-        tickWorld(&world, cam.pos);
+        PROFILE_SCOPE(PHASE_TICK_WORLD) { tickWorld(&world, cam.pos); }
 
         // Process events
         glfwPollEvents();
-        processInput(window, delta_time);
+        processInput(window, delta_time, replay.mode == REPLAY_PLAYBACK);
+        recordCameraSample(&replay);
         clearWindow(window);
 
         // Apply uniforms and render
-        applyUniformBufferBundle(&camera_uniform_buffer_bundle);
-        renderWorld(&world, &chunk_program, &current_chunk_pointer, window, cam.dir, cam.pos);
+        PROFILE_SCOPE(PHASE_APPLY_UNIFORMS) { applyUniformBufferBundle(&camera_uniform_buffer_bundle); }
+        PROFILE_SCOPE(PHASE_RENDER_WORLD) {
+            beginGPUTimer(&world_gpu_timer);
+            renderWorld(&world, &chunk_program, &current_chunk_pointer, window, cam.dir, cam.pos);
+            endGPUTimer(&world_gpu_timer);
+        }
         // model_pointer = &(test_chunk->model);
         // renderWithSSBOVAOBundle(window, &chunk_program, &(test_chunk->buffer_bundle), 0, test_chunk->buffer_bundle.length * FACES_PER_VOXEL * VERTS_PER_FACE / VALS_PER_VOXEL);
         
-        getrusage(RUSAGE_SELF, &r_usage);
         char *debug_string;
         if(
             !asprintf(&debug_string, "FPS: %03d MEM: %.3fMB POS: (%.3f, %.3f, %.3f) C: %d RD: %u", 
                       fps, 
-                      r_usage.ru_maxrss / 1048576., 
+                      getTrackedMemoryTotal() / 1048576., 
                       cam.pos[0], cam.pos[1], cam.pos[2], 
                       /* world.chunks.size */ world.chunk_render_count,
                       world.render_distance)
         ) { printf("ERROR: Error creating debug string!\n"); return -1; }
-        renderText(&text_buffer_bundle, &text_program, debug_string, (vec2) {10, 10}, 0.15);
+        char *gpu_string;
+        if(
+            !asprintf(&gpu_string, "WORLD CPU: %.2fms GPU: %.2fms TEXT CPU: %.2fms GPU: %.2fms",
+                      getProfilerFrame(0)->phase_times[PHASE_RENDER_WORLD] * 1000.,
+                      world_gpu_timer.time * 1000.,
+                      getProfilerFrame(0)->phase_times[PHASE_RENDER_TEXT] * 1000.,
+                      text_gpu_timer.time * 1000.)
+        ) { printf("ERROR: Error creating GPU debug string!\n"); return -1; }
+        PROFILE_SCOPE(PHASE_RENDER_TEXT) {
+            beginGPUTimer(&text_gpu_timer);
+            renderText(&text_buffer_bundle, &text_program, debug_string, (vec2) {10, 10}, 0.15);
+            renderText(&text_buffer_bundle, &text_program, gpu_string, (vec2) {10, 10 + DEBUG_LINE_HEIGHT}, 0.15);
+            renderProfilerOverlay(&text_buffer_bundle, &text_program, 10 + 2 * DEBUG_LINE_HEIGHT);
+            endGPUTimer(&text_gpu_timer);
+        }
         free(debug_string);
+        free(gpu_string);
+
+        PROFILE_SCOPE(PHASE_FINISH_RENDER) { finishRender(window); }
 
-        finishRender(window);
+        if (profiler.frame_count == 0) {
+            recordStartupStage("first_frame", getPreciseTimeStamp() - first_frame_start);
+            printStartupReport();
+        }
+
+        profilerEndFrame();
+        endCounterFrame();
+        checkForHitch(&hitch_detector, &world);
+        recordFrameTiming(&replay, getProfilerFrame(0));
     }
 
-    // freeVector(&world.chunks);
+    printHitchReport(&hitch_detector);
+    printReplayReport(&replay);
+    freeReplay(&replay);
+    if (profile_csv_path != NULL) { dumpProfilerCSV(profile_csv_path); }
+    if (trace_path != NULL) { writeTrace(trace_path); }
+    printMemoryReport();
+
+    freeGPUTimer(&world_gpu_timer);
+    freeGPUTimer(&text_gpu_timer);
+    freeWorld(&world);
     freeProgram(&text_program);
     freeProgram(&chunk_program);
     freeUniformBuffer(&camera_uniform_buffer_bundle);
@@ -0,0 +1,66 @@
+#ifndef MEMORY
+#define MEMORY
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Byte counters for the main memory consumers, so render distance can be sized against a budget.
+// MEMORY_CHUNK_VOXELS is the cold data of each chunk (voxel storage, occupancy masks), MEMORY_CHUNK_VECTOR the hot Chunk structs,
+// MEMORY_CHUNK_INDEX the region directory used to find chunks by position.
+
+#define MEMORY_UNTRACKED -1
+
+typedef enum MemoryArea {
+    MEMORY_CHUNK_VOXELS,
+    MEMORY_CHUNK_VECTOR,
+    MEMORY_CHUNK_INDEX,
+    MEMORY_MESHER_STAGING,
+    MEMORY_GPU_SSBO,
+    MEMORY_AREA_COUNT
+} MemoryArea;
+
+const char *memory_area_names[MEMORY_AREA_COUNT] = {
+    "voxels",
+    "chunks",
+    "index",
+    "staging",
+    "ssbo"
+};
+
+typedef struct MemoryStats {
+    long long current[MEMORY_AREA_COUNT];
+    long long peak[MEMORY_AREA_COUNT];
+} MemoryStats;
+
+MemoryStats memory_stats;
+
+void trackMemory(int area, long long bytes) {
+    if (area < 0 || area >= MEMORY_AREA_COUNT) { return; }
+
+    memory_stats.current[area] += bytes;
+    if (memory_stats.current[area] > memory_stats.peak[area]) { memory_stats.peak[area] = memory_stats.current[area]; }
+}
+
+long long getTrackedMemoryTotal() {
+    long long total = 0;
+    for (int area = 0; area < MEMORY_AREA_COUNT; area++) { total += memory_stats.current[area]; }
+    return total;
+}
+
+// Writes current MB per area, e.g. "voxels 12.0 chunks 1.2 staging 0.0 ssbo 3.4"
+void getMemoryString(char *buffer, size_t buffer_size) {
+    size_t written = 0;
+    for (int area = 0; area < MEMORY_AREA_COUNT && written < buffer_size; area++) {
+        written += snprintf(buffer + written, buffer_size - written, "%s%s %.1f", area == 0 ? "" : " ", memory_area_names[area], memory_stats.current[area] / 1048576.);
+    }
+}
+
+void printMemoryReport() {
+    printf("Memory report (MB):\n");
+    for (int area = 0; area < MEMORY_AREA_COUNT; area++) {
+        printf("  %-8s current %9.3f peak %9.3f\n", memory_area_names[area], memory_stats.current[area] / 1048576., memory_stats.peak[area] / 1048576.);
+    }
+    printf("  %-8s current %9.3f\n", "total", getTrackedMemoryTotal() / 1048576.);
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include <time.h>
 #include <stdio.h>
 #include <errno.h>
+#include <unistd.h>
 
 // https://blog.pkh.me/p/36-figuring-out-round%2C-floor-and-ceil-with-integer-division.html
 int divFloor(int a, int b) { return a/b - (a%b!=0 && (a^b)<0); }
@@ -30,4 +31,28 @@ float getTimeStamp() {
     return (float) spec.tv_sec + spec.tv_nsec / 1.0e9;
 }
 
+// Float seconds lose sub-millisecond precision once the monotonic clock is large, so use this for timings
+double getPreciseTimeStamp() {
+    struct timespec spec;
+    if (clock_gettime(CLOCK_MONOTONIC, &spec) != 0) {
+        printf("ERROR: in clock_gettime. errno: %d\n", errno);
+        return -1.;
+    }
+
+    return (double) spec.tv_sec + spec.tv_nsec / 1.0e9;
+}
+
+// Current resident set size in bytes (Linux only), unlike ru_maxrss this can go down
+long getResidentMemory() {
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (file == NULL) { return -1; }
+
+    long pages_total, pages_resident;
+    int read = fscanf(file, "%ld %ld", &pages_total, &pages_resident);
+    fclose(file);
+    if (read != 2) { return -1; }
+
+    return pages_resident * sysconf(_SC_PAGESIZE);
+}
+
 #endif
@@ -4,6 +4,21 @@
 #include "cglm/noise.h"
 #include <cglm/cglm.h>
 
+// Perlin noise has no seed of its own, so a seed picks a different region of the noise field
+void getSeedOffset(int seed, vec2 dest) {
+    unsigned int hash = (unsigned int) seed * 2654435761u;
+    dest[0] = (hash & 0xFFFF) / 256.;
+    dest[1] = (hash >> 16) / 256.;
+}
+
+// Cheap deterministic per position hash, for small per voxel variations
+unsigned int hashPosition(int x, int y, int z) {
+    unsigned int hash = (unsigned int) x * 73856093u ^ (unsigned int) y * 19349663u ^ (unsigned int) z * 83492791u;
+    hash ^= hash >> 13;
+    hash *= 0x5bd1e995u;
+    return hash ^ (hash >> 15);
+}
+
 float layered2DNoise(vec2 pos, int octaves, float persistance, float octave_scale) {
     float noise = 0;
     float frequency = 1;
@@ -52,6 +52,14 @@ void cameraRotate(float yaw, float pitch) {
     glm_vec3_normalize(cam.forward);
 }
 
+// Used by replays to drive the camera directly
+void setCameraState(vec3 pos, float yaw, float pitch) {
+    glm_vec3_copy(pos, cam.pos);
+    cam.yaw = yaw;
+    cam.pitch = pitch;
+    cameraRotate(0, 0);
+}
+
 double prev_x = 0;
 double prev_y = 0;
 void cursorPositionCallback(GLFWwindow *window, double x, double y) {
@@ -0,0 +1,79 @@
+#ifndef POOL
+#define POOL
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "memory.c"
+#include "counters.c"
+#include "vector.c"
+
+// Fixed size item allocator. Items live in slabs that are never moved or resized, so a pointer stays valid for as long as its
+// item is allocated. Released items go on a free list threaded through the items themselves and are handed out again before
+// a new slab is made, so steady churn (e.g. streaming chunks in and out) never reaches malloc.
+// Memory is counted per item in use rather than per slab, spare slab items are bounded by the peak usage.
+
+typedef struct Pool {
+    size_t item_size; // At least sizeof(void *), the free list link is stored in released items
+    size_t slab_items;
+    Vector slabs; // void * per slab, initialised on first use
+    void *free_list;
+    size_t used;
+    size_t capacity; // Items across all slabs
+    int memory_area; // MemoryArea the items in use are counted against, or MEMORY_UNTRACKED
+} Pool;
+
+#define poolInit(item_size_, slab_items_, memory_area_) ((Pool) { .item_size = (item_size_), .slab_items = (slab_items_), .slabs = { .vals = NULL }, .free_list = NULL, .used = 0, .capacity = 0, .memory_area = (memory_area_) })
+
+int poolAddSlab(Pool *pool) {
+    if (pool->slabs.vals == NULL) { pool->slabs = vectorInit(sizeof(void *), 4); }
+
+    char *slab = malloc(pool->item_size * pool->slab_items);
+    if (slab == NULL) { return 0; }
+    if (!vectorPush(&pool->slabs, &slab)) { free(slab); return 0; }
+
+    // Link back to front so items are handed out in address order
+    for (size_t i = pool->slab_items; i > 0; i--) {
+        void *item = slab + (i - 1) * pool->item_size;
+        *(void **) item = pool->free_list;
+        pool->free_list = item;
+    }
+    pool->capacity += pool->slab_items;
+    incrementCounter(COUNTER_POOL_SLABS, 1);
+
+    return 1;
+}
+
+// Returns an uninitialised item, or NULL if out of memory
+void *poolAlloc(Pool *pool) {
+    if (pool->free_list == NULL && !poolAddSlab(pool)) { return NULL; }
+
+    void *item = pool->free_list;
+    pool->free_list = *(void **) item;
+    pool->used++;
+    trackMemory(pool->memory_area, pool->item_size);
+
+    return item;
+}
+
+void poolRelease(Pool *pool, void *item) {
+    if (item == NULL) { return; }
+
+    *(void **) item = pool->free_list;
+    pool->free_list = item;
+    pool->used--;
+    trackMemory(pool->memory_area, -(long long) pool->item_size);
+}
+
+// Frees every slab, only valid once no items are in use. The pool can be used again afterwards
+void freePool(Pool *pool) {
+    if (pool->used != 0) { printf("ERROR: Freeing a pool with %zu items still in use.\n", pool->used); return; }
+    if (pool->slabs.vals == NULL) { return; }
+
+    for (size_t i = 0; i < pool->slabs.size; i++) { free(*(void **) vectorIndex(&pool->slabs, i)); }
+    freeVector(&pool->slabs);
+    pool->free_list = NULL;
+    pool->capacity = 0;
+}
+
+#endif
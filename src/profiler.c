@@ -0,0 +1,200 @@
+#ifndef PROFILER
+#define PROFILER
+
+#include "misc.c"
+#include "trace.c"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+// Scoped CPU timers for the main loop.
+// Phases nest (e.g. remeshing inside tickWorld), and a phase entered more than once in a frame accumulates.
+// The last PROFILER_HISTORY frames are kept in a ring buffer for the overlay and the CSV dump.
+
+#define PROFILER_HISTORY 240
+#define PROFILER_MAX_DEPTH 16
+
+typedef enum ProfilerPhase {
+    PHASE_FRAME,
+    PHASE_TICK_WORLD,
+    PHASE_REMESH,
+    PHASE_STREAM,
+    PHASE_APPLY_UNIFORMS,
+    PHASE_RENDER_WORLD,
+    PHASE_RENDER_TEXT,
+    PHASE_FINISH_RENDER,
+    PHASE_COUNT
+} ProfilerPhase;
+
+const char *profiler_phase_names[PHASE_COUNT] = {
+    "frame",
+    "tick",
+    "remesh",
+    "stream",
+    "ubo",
+    "world",
+    "text",
+    "swap"
+};
+
+typedef struct ProfilerFrame {
+    double phase_times[PHASE_COUNT]; // Seconds, inclusive of nested phases
+} ProfilerFrame;
+
+typedef struct Profiler {
+    ProfilerFrame frames[PROFILER_HISTORY];
+    unsigned int frame_index; // Frame currently being recorded
+    unsigned long frame_count;
+    ProfilerPhase stack[PROFILER_MAX_DEPTH];
+    double stack_starts[PROFILER_MAX_DEPTH];
+    int depth;
+} Profiler;
+
+Profiler profiler;
+
+// Returns 0 if the stack is full and the phase was not pushed, it must then not be ended
+int profilerBegin(ProfilerPhase phase) {
+    if (profiler.depth >= PROFILER_MAX_DEPTH) { printf("ERROR: Profiler stack overflow.\n"); return 0; }
+    profiler.stack[profiler.depth] = phase;
+    profiler.stack_starts[profiler.depth] = getPreciseTimeStamp();
+    profiler.depth++;
+    traceBegin(profiler_phase_names[phase]);
+    return 1;
+}
+
+void profilerEnd() {
+    if (profiler.depth <= 0) { printf("ERROR: Profiler stack underflow.\n"); return; }
+    profiler.depth--;
+    traceEnd(profiler_phase_names[profiler.stack[profiler.depth]]);
+    double elapsed = getPreciseTimeStamp() - profiler.stack_starts[profiler.depth];
+    profiler.frames[profiler.frame_index].phase_times[profiler.stack[profiler.depth]] += elapsed;
+}
+
+// Runs the following statement or block as a timed phase. If the phase could not be pushed it runs untimed, so the enclosing phase is not ended early
+#define PROFILE_SCOPE(phase) for (int profile_scope_pushed = profilerBegin(phase), profile_scope_once = 1; profile_scope_once; profile_scope_once = (profile_scope_pushed ? profilerEnd() : (void) 0, 0))
+
+void profilerBeginFrame() {
+    memset(&profiler.frames[profiler.frame_index], 0, sizeof(ProfilerFrame));
+    profilerBegin(PHASE_FRAME);
+}
+
+void profilerEndFrame() {
+    profilerEnd();
+    if (profiler.depth != 0) { printf("ERROR: Unbalanced profiler phases at end of frame.\n"); profiler.depth = 0; }
+
+    profiler.frame_index = (profiler.frame_index + 1) % PROFILER_HISTORY;
+    profiler.frame_count++;
+}
+
+unsigned int profilerHistorySize() {
+    return profiler.frame_count < PROFILER_HISTORY ? profiler.frame_count : PROFILER_HISTORY;
+}
+
+// 0 is the last completed frame, 1 the one before that, etc.
+ProfilerFrame *getProfilerFrame(unsigned int frames_ago) {
+    return &profiler.frames[(profiler.frame_index + 2 * PROFILER_HISTORY - 1 - frames_ago) % PROFILER_HISTORY];
+}
+
+double getProfilerAverage(ProfilerPhase phase) {
+    unsigned int history = profilerHistorySize();
+    if (history == 0) { return 0; }
+
+    double total = 0;
+    for (unsigned int i = 0; i < history; i++) { total += getProfilerFrame(i)->phase_times[phase]; }
+
+    return total / history;
+}
+
+// Writes the average ms per phase over the history, e.g. "frame 4.12 tick 0.01 ..."
+void getProfilerBreakdown(char *buffer, size_t buffer_size) {
+    size_t written = 0;
+    for (int phase = 0; phase < PHASE_COUNT && written < buffer_size; phase++) {
+        written += snprintf(buffer + written, buffer_size - written, "%s%s %.2f", phase == 0 ? "" : " ", profiler_phase_names[phase], getProfilerAverage(phase) * 1000.);
+    }
+}
+
+// Writes one row of an ASCII frame time graph covering the last `columns` frames, oldest on the left.
+// Row 0 is the top of the graph, and the graph is scaled to the slowest frame shown.
+void getProfilerGraphRow(char *buffer, unsigned int row, unsigned int rows, unsigned int columns) {
+    unsigned int history = profilerHistorySize();
+    if (columns > history) { columns = history; }
+
+    double max_time = 0;
+    for (unsigned int i = 0; i < columns; i++) {
+        double time = getProfilerFrame(i)->phase_times[PHASE_FRAME];
+        if (time > max_time) { max_time = time; }
+    }
+
+    for (unsigned int i = 0; i < columns; i++) {
+        double time = getProfilerFrame(columns - 1 - i)->phase_times[PHASE_FRAME];
+        unsigned int height = max_time > 0 ? (unsigned int) (time / max_time * rows + 0.5) : 0;
+        buffer[i] = height >= rows - row ? '#' : '.';
+    }
+    buffer[columns] = '\0';
+}
+
+// Startup stages are timed once each, separately from the per frame phases
+#define MAX_STARTUP_STAGES 16
+
+typedef struct StartupStage {
+    const char *name;
+    double time; // Seconds
+} StartupStage;
+
+StartupStage startup_stages[MAX_STARTUP_STAGES];
+int startup_stage_count = 0;
+double startup_stage_start = 0;
+
+void recordStartupStage(const char *name, double time) {
+    if (startup_stage_count >= MAX_STARTUP_STAGES) { printf("ERROR: Too many startup stages.\n"); return; }
+    startup_stages[startup_stage_count++] = (StartupStage) { .name = name, .time = time };
+}
+
+void beginStartupStage(const char *name) {
+    traceBegin(name);
+    startup_stage_start = getPreciseTimeStamp();
+}
+
+void endStartupStage(const char *name) {
+    recordStartupStage(name, getPreciseTimeStamp() - startup_stage_start);
+    traceEnd(name);
+}
+
+void printStartupReport() {
+    double total = 0;
+    printf("Startup breakdown (ms):\n");
+    for (int i = 0; i < startup_stage_count; i++) {
+        printf("  %-14s %9.3f\n", startup_stages[i].name, startup_stages[i].time * 1000.);
+        total += startup_stages[i].time;
+    }
+    printf("  %-14s %9.3f\n", "total", total * 1000.);
+}
+
+int dumpProfilerCSV(char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        int errsv = errno;
+        printf("ERROR: Could not open %s for the profiler dump. (%d: %s)\n", path, errsv, strerror(errsv));
+        return 0;
+    }
+
+    unsigned int history = profilerHistorySize();
+    fprintf(file, "frame");
+    for (int phase = 0; phase < PHASE_COUNT; phase++) { fprintf(file, ",%s_ms", profiler_phase_names[phase]); }
+    fprintf(file, "\n");
+
+    for (unsigned int i = history; i > 0; i--) {
+        ProfilerFrame *frame = getProfilerFrame(i - 1);
+        fprintf(file, "%lu", profiler.frame_count - i);
+        for (int phase = 0; phase < PHASE_COUNT; phase++) { fprintf(file, ",%.4f", frame->phase_times[phase] * 1000.); }
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+    printf("Wrote %u profiled frames to %s\n", history, path);
+
+    return 1;
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef REGION
+#define REGION
+
+#include "misc.c"
+
+#include "cglm/cglm.h"
+
+// Regions group REGION_SIZE^3 chunks, each with a fixed table from position in the region to slot in the world's chunk vector.
+// Finding a chunk is a region lookup plus an array index, and a region can be loaded or dropped as a unit.
+// The region grid is also the intended unit for on disk region files.
+
+#define REGION_SIZE 16 // Chunks per axis
+#define REGION_VOLUME (REGION_SIZE * REGION_SIZE * REGION_SIZE)
+#define REGION_NO_CHUNK -1
+
+typedef struct Region {
+    ivec3 region_pos;
+    int chunk_count;
+    int chunk_slots[REGION_VOLUME]; // Index into World.chunks, or REGION_NO_CHUNK
+} Region;
+
+#define getRegionPos(chunk_pos) {divFloor((chunk_pos)[0], REGION_SIZE), divFloor((chunk_pos)[1], REGION_SIZE), divFloor((chunk_pos)[2], REGION_SIZE)}
+#define getRegionChunkIndex(chunk_pos) ((mod((chunk_pos)[0], REGION_SIZE) * REGION_SIZE + mod((chunk_pos)[1], REGION_SIZE)) * REGION_SIZE + mod((chunk_pos)[2], REGION_SIZE))
+
+void initRegion(Region *region, ivec3 region_pos) {
+    glm_ivec3_copy(region_pos, region->region_pos);
+    region->chunk_count = 0;
+    for (int i = 0; i < REGION_VOLUME; i++) { region->chunk_slots[i] = REGION_NO_CHUNK; }
+}
+
+#endif
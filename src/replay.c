@@ -0,0 +1,192 @@
+#ifndef REPLAY
+#define REPLAY
+
+#include "cglm/cglm.h"
+#include "player.c"
+#include "vector.c"
+#include "misc.c"
+#include "profiler.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// Camera flythrough recording and deterministic playback.
+// Recording stores the camera state each frame along with the time since recording started.
+// Playback steps time by a fixed amount each frame and interpolates between samples,
+// so the same path is rendered with the same number of frames regardless of the recording frame rate.
+
+#define REPLAY_TIMESTEP (1. / 60.)
+#define REPLAY_HEADER "# c-voxel camera replay v1"
+
+typedef enum ReplayMode {
+    REPLAY_OFF,
+    REPLAY_RECORD,
+    REPLAY_PLAYBACK
+} ReplayMode;
+
+typedef struct CameraSample {
+    double time;
+    vec3 pos;
+    float yaw;
+    float pitch;
+} CameraSample;
+
+typedef struct Replay {
+    ReplayMode mode;
+    FILE *file;
+    double start_time;
+    double time;
+    size_t sample_cursor;
+    Vector samples; // CameraSample
+    Vector frame_timings; // ProfilerFrame
+} Replay;
+
+int startRecording(Replay *replay, char *path) {
+    replay->file = fopen(path, "w");
+    if (replay->file == NULL) {
+        int errsv = errno;
+        printf("ERROR: Could not open %s for recording. (%d: %s)\n", path, errsv, strerror(errsv));
+        return 0;
+    }
+
+    fprintf(replay->file, "%s\n", REPLAY_HEADER);
+    replay->mode = REPLAY_RECORD;
+    replay->start_time = getPreciseTimeStamp();
+    printf("Recording camera to %s\n", path);
+
+    return 1;
+}
+
+void recordCameraSample(Replay *replay) {
+    if (replay->mode != REPLAY_RECORD) { return; }
+
+    fprintf(replay->file, "%.6f %.6f %.6f %.6f %.6f %.6f\n",
+            getPreciseTimeStamp() - replay->start_time,
+            cam.pos[0], cam.pos[1], cam.pos[2],
+            cam.yaw, cam.pitch);
+}
+
+int loadReplay(Replay *replay, char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        int errsv = errno;
+        printf("ERROR: Could not open replay %s. (%d: %s)\n", path, errsv, strerror(errsv));
+        return 0;
+    }
+
+    char header[64];
+    if (fgets(header, sizeof(header), file) == NULL || strncmp(header, REPLAY_HEADER, strlen(REPLAY_HEADER)) != 0) {
+        printf("ERROR: %s is not a camera replay.\n", path);
+        fclose(file);
+        return 0;
+    }
+
+    replay->samples = vectorInit(sizeof(CameraSample), 256);
+    CameraSample sample;
+    while (fscanf(file, "%lf %f %f %f %f %f", &sample.time, &sample.pos[0], &sample.pos[1], &sample.pos[2], &sample.yaw, &sample.pitch) == 6) {
+        vectorPush(&replay->samples, &sample);
+    }
+    fclose(file);
+
+    if (replay->samples.size < 2) {
+        printf("ERROR: Replay %s needs at least 2 samples.\n", path);
+        freeVector(&replay->samples);
+        return 0;
+    }
+
+    replay->frame_timings = vectorInit(sizeof(ProfilerFrame), 256);
+    replay->mode = REPLAY_PLAYBACK;
+    replay->time = 0;
+    replay->sample_cursor = 0;
+    printf("Loaded replay %s (%zu samples)\n", path, replay->samples.size);
+
+    return 1;
+}
+
+// Moves the camera to the next fixed timestep of the replay. Returns 0 once the replay has finished.
+int replayCamera(Replay *replay) {
+    if (replay->mode != REPLAY_PLAYBACK) { return 1; }
+
+    CameraSample *last = vectorIndex(&replay->samples, replay->samples.size - 1);
+    if (replay->time > last->time) { return 0; }
+
+    while (replay->sample_cursor + 2 < replay->samples.size &&
+           ((CameraSample *) vectorIndex(&replay->samples, replay->sample_cursor + 1))->time <= replay->time) {
+        replay->sample_cursor++;
+    }
+
+    CameraSample *a = vectorIndex(&replay->samples, replay->sample_cursor);
+    CameraSample *b = vectorIndex(&replay->samples, replay->sample_cursor + 1);
+    float t = b->time > a->time ? (replay->time - a->time) / (b->time - a->time) : 1;
+    if (t < 0) { t = 0; }
+    if (t > 1) { t = 1; }
+
+    vec3 pos;
+    glm_vec3_lerp(a->pos, b->pos, t, pos);
+    setCameraState(pos, a->yaw + (b->yaw - a->yaw) * t, a->pitch + (b->pitch - a->pitch) * t);
+
+    replay->time += REPLAY_TIMESTEP;
+
+    return 1;
+}
+
+void recordFrameTiming(Replay *replay, ProfilerFrame *frame) {
+    if (replay->mode != REPLAY_PLAYBACK) { return; }
+    vectorPush(&replay->frame_timings, frame);
+}
+
+int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank percentile of an already sorted array
+double percentile(double *sorted, size_t count, double p) {
+    size_t rank = (size_t) ceil(p / 100. * count);
+    if (rank < 1) { rank = 1; }
+    return sorted[rank - 1];
+}
+
+void printReplayReport(Replay *replay) {
+    if (replay->mode != REPLAY_PLAYBACK || replay->frame_timings.size == 0) { return; }
+
+    size_t count = replay->frame_timings.size;
+    double *totals = malloc(sizeof(double) * count);
+    if (totals == NULL) { printf("ERROR: Could not allocate replay report.\n"); return; }
+
+    size_t worst = 0;
+    for (size_t i = 0; i < count; i++) {
+        ProfilerFrame *frame = vectorIndex(&replay->frame_timings, i);
+        totals[i] = frame->phase_times[PHASE_FRAME];
+        if (totals[i] > totals[worst]) { worst = i; }
+    }
+    qsort(totals, count, sizeof(double), compareDoubles);
+
+    ProfilerFrame *worst_frame = vectorIndex(&replay->frame_timings, worst);
+    printf("Replay: %zu frames at %.1f Hz fixed timestep\n", count, 1. / REPLAY_TIMESTEP);
+    printf("Frame time ms: p50 %.3f p95 %.3f p99 %.3f max %.3f\n",
+           percentile(totals, count, 50) * 1000.,
+           percentile(totals, count, 95) * 1000.,
+           percentile(totals, count, 99) * 1000.,
+           totals[count - 1] * 1000.);
+    printf("Worst frame %zu (t = %.3fs) ms:", worst, worst * REPLAY_TIMESTEP);
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        printf(" %s %.3f", profiler_phase_names[phase], worst_frame->phase_times[phase] * 1000.);
+    }
+    printf("\n");
+
+    free(totals);
+}
+
+void freeReplay(Replay *replay) {
+    if (replay->mode == REPLAY_RECORD) { fclose(replay->file); }
+    if (replay->mode == REPLAY_PLAYBACK) {
+        freeVector(&replay->samples);
+        freeVector(&replay->frame_timings);
+    }
+    replay->mode = REPLAY_OFF;
+}
+
+#endif
@@ -7,14 +7,14 @@
 #define VERTEX_PULLING_SCALE 6
 
 // struct VoxelData {
-//     uint x : 4;
-//     uint y : 4;
-//     uint z : 4;
+//     uint x : 5;
+//     uint y : 5;
+//     uint z : 5;
 //     uint r : 4;
 //     uint g : 4;
 //     uint b : 4;
 //     uint face_id : 3;
-//     uint flags : 5;
+//     uint flags : 2;
 // };
 
 // Face table:
@@ -90,17 +90,17 @@ uniform uint lod_scale;
 void main(){
     uint voxel_index = gl_VertexID / VERTEX_PULLING_SCALE;
     uint data = voxels[voxel_index];
-    uint x = (data) & 0xF;
-    uint y = (data >> 4) & 0xF;
-    uint z = (data >> 8) & 0xF;
+    uint x = (data) & 0x1F;
+    uint y = (data >> 5) & 0x1F;
+    uint z = (data >> 10) & 0x1F;
     vec3 pos = vec3(x, y, z);
 
-    uint r = (data >> 12) & 0xF;
-    uint g = (data >> 16) & 0xF;
-    uint b = (data >> 20) & 0xF;
+    uint r = (data >> 15) & 0xF;
+    uint g = (data >> 19) & 0xF;
+    uint b = (data >> 23) & 0xF;
     vec3 col = vec3(r, g, b) / 16.;
 
-    uint face_id = (data >> 24) & 0x7;
+    uint face_id = (data >> 27) & 0x7;
 
     uint vert_offset = gl_VertexID % VERTEX_PULLING_SCALE;
 
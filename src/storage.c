@@ -0,0 +1,602 @@
+#ifndef STORAGE
+#define STORAGE
+
+#include "memory.c"
+#include "layout.c"
+#include "tree.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+// Voxel payload storage for a chunk. Chunks hold a ChunkStorage and only ever go through
+// getStorageVoxel / setStorageVoxel, so the representation can differ per chunk.
+//  - Flat: one byte per voxel, fastest to read.
+//  - Palette: a small per chunk palette of block IDs plus packed 1/2/4/8 bit indices into it.
+//    Starts at 1 bit and widens automatically when a write needs a new palette entry.
+//  - RLE: runs of identical blocks per vertical (x, z) column. Heightmap terrain is a handful of runs per column.
+//    Columns can be walked run by run with a ColumnRunIterator, which also works (slower) on the other modes.
+//  - Tree: sparse 64-tree (see tree.c), air costs nothing, LOD cells are read from the masks of the matching tree level
+//    and rays skip empty space. Only used for chunks sparse enough to be smaller than flat storage (see chooseStorageMode).
+//  - Uniform: every voxel is the same block, no array at all. The first differing write expands it
+//    into expand_mode (default_storage_mode unless changed), compactStorage turns a chunk back into uniform storage.
+// Writes one voxel at a time are meant for edits. Bulk fills (generation) should write flat storage and convertStorage it once.
+
+typedef uint8_t Voxel;
+
+#define STORAGE_PALETTE_MAX_BITS 8 // Voxel is a byte, so 256 palette entries is always enough
+#define STORAGE_RLE_MAX_EDGE 32 // Chunk edges go up to 32. Keeps every run index (at most edge^3) within the 16 bit column_start
+
+typedef enum ChunkStorageMode {
+    STORAGE_FLAT,
+    STORAGE_PALETTE,
+    STORAGE_RLE,
+    STORAGE_TREE,
+    STORAGE_UNIFORM // Not selectable as a default, chunks fall into it on their own
+} ChunkStorageMode;
+
+typedef struct PaletteStorage {
+    Voxel *palette; // Capacity is 1 << bits
+    unsigned int palette_size;
+    unsigned int bits;
+    uint64_t *data;
+} PaletteStorage;
+
+typedef struct VoxelRun {
+    Voxel voxel;
+    uint8_t length;
+} VoxelRun;
+
+typedef struct RLEStorage {
+    uint16_t *column_start; // edge * edge + 1 entries, the runs of column c are runs[column_start[c]] up to runs[column_start[c + 1]]
+    VoxelRun *runs; // Bottom to top within a column
+    unsigned int run_count;
+    unsigned int run_capacity;
+} RLEStorage;
+
+typedef struct ChunkStorage {
+    ChunkStorageMode mode;
+    unsigned int volume;
+    unsigned int edge; // volume = edge^3
+    ChunkStorageMode expand_mode; // What uniform storage expands into on the first differing write
+    union {
+        Voxel *flat;
+        PaletteStorage palette;
+        RLEStorage rle;
+        TreeStorage tree;
+        Voxel uniform;
+    };
+} ChunkStorage;
+
+const char *storage_mode_names[] = { "flat", "palette", "rle", "tree", "uniform" };
+
+ChunkStorageMode default_storage_mode = STORAGE_FLAT;
+
+#define paletteIndicesPerWord(bits) (64 / (bits))
+#define paletteWordCount(volume, bits) (((volume) + paletteIndicesPerWord(bits) - 1) / paletteIndicesPerWord(bits))
+
+// Vertical columns in the chunk index layout (see layout.c), column = x * edge + z
+#define getStorageColumn(storage, index) (decodeVoxelX((storage)->edge, index) * (storage)->edge + decodeVoxelZ((storage)->edge, index))
+#define getStorageColumnY(storage, index) decodeVoxelY((storage)->edge, index)
+#define getStorageColumnIndex(storage, column, y) encodeVoxelIndex((storage)->edge, (column) / (storage)->edge, y, (column) % (storage)->edge)
+
+// Parses a --storage argument, returns 0 if the name is unknown
+int parseStorageMode(const char *name, ChunkStorageMode *mode) {
+    for (int i = 0; i < STORAGE_UNIFORM; i++) {
+        if (strcmp(name, storage_mode_names[i]) == 0) { *mode = i; return 1; }
+    }
+    printf("ERROR: Unknown storage mode \"%s\"\n", name);
+    return 0;
+}
+
+size_t getStorageBytes(ChunkStorage *storage) {
+    switch (storage->mode) {
+        case STORAGE_FLAT: return storage->volume * sizeof(Voxel);
+        case STORAGE_PALETTE: return (1u << storage->palette.bits) * sizeof(Voxel) + paletteWordCount(storage->volume, storage->palette.bits) * sizeof(uint64_t);
+        case STORAGE_RLE: return (storage->edge * storage->edge + 1) * sizeof(uint16_t) + storage->rle.run_capacity * sizeof(VoxelRun);
+        case STORAGE_TREE: return getTreeBytes(&storage->tree);
+        case STORAGE_UNIFORM: return 0;
+    }
+    return 0;
+}
+
+unsigned int getPaletteIndex(PaletteStorage *palette, unsigned int index) {
+    unsigned int per_word = paletteIndicesPerWord(palette->bits);
+    uint64_t word = palette->data[index / per_word];
+    return (word >> ((index % per_word) * palette->bits)) & ((1ULL << palette->bits) - 1);
+}
+
+void setPaletteIndex(PaletteStorage *palette, unsigned int index, unsigned int palette_index) {
+    unsigned int per_word = paletteIndicesPerWord(palette->bits);
+    unsigned int shift = (index % per_word) * palette->bits;
+    uint64_t mask = ((1ULL << palette->bits) - 1) << shift;
+    uint64_t *word = &palette->data[index / per_word];
+    *word = (*word & ~mask) | ((uint64_t) palette_index << shift);
+}
+
+// Doubles the index width and repacks, returns 0 on allocation failure
+int growPalette(ChunkStorage *storage) {
+    PaletteStorage *palette = &storage->palette;
+    if (palette->bits >= STORAGE_PALETTE_MAX_BITS) { return 0; }
+
+    size_t old_bytes = getStorageBytes(storage);
+    PaletteStorage grown = {
+        .palette_size = palette->palette_size,
+        .bits = palette->bits * 2
+    };
+    grown.palette = malloc((1u << grown.bits) * sizeof(Voxel));
+    grown.data = calloc(paletteWordCount(storage->volume, grown.bits), sizeof(uint64_t));
+    if (grown.palette == NULL || grown.data == NULL) { free(grown.palette); free(grown.data); return 0; }
+
+    memcpy(grown.palette, palette->palette, palette->palette_size * sizeof(Voxel));
+    for (unsigned int i = 0; i < storage->volume; i++) { setPaletteIndex(&grown, i, getPaletteIndex(palette, i)); }
+
+    free(palette->palette);
+    free(palette->data);
+    *palette = grown;
+    trackMemory(MEMORY_CHUNK_VOXELS, (long long) getStorageBytes(storage) - (long long) old_bytes);
+
+    return 1;
+}
+
+// Every voxel starts as `fill`
+int initStorage(ChunkStorage *storage, ChunkStorageMode mode, unsigned int volume, Voxel fill) {
+    storage->mode = mode;
+    storage->volume = volume;
+    storage->edge = 1;
+    while (storage->edge * storage->edge * storage->edge < volume) { storage->edge++; }
+    storage->expand_mode = default_storage_mode;
+
+    switch (mode) {
+        case STORAGE_FLAT:
+            storage->flat = malloc(volume * sizeof(Voxel));
+            if (storage->flat == NULL) { return 0; }
+            memset(storage->flat, fill, volume * sizeof(Voxel));
+            break;
+        case STORAGE_PALETTE:
+            storage->palette.bits = 1;
+            storage->palette.palette_size = 1;
+            storage->palette.palette = malloc((1u << storage->palette.bits) * sizeof(Voxel));
+            storage->palette.data = calloc(paletteWordCount(volume, storage->palette.bits), sizeof(uint64_t));
+            if (storage->palette.palette == NULL || storage->palette.data == NULL) {
+                free(storage->palette.palette);
+                free(storage->palette.data);
+                return 0;
+            }
+            storage->palette.palette[0] = fill;
+            break;
+        case STORAGE_RLE: {
+            unsigned int columns = storage->edge * storage->edge;
+            if (storage->edge > STORAGE_RLE_MAX_EDGE) {
+                printf("ERROR: Chunks of %u^3 voxels are too large for RLE storage.\n", storage->edge);
+                return 0;
+            }
+
+            // One run per column to start with
+            storage->rle.column_start = malloc((columns + 1) * sizeof(uint16_t));
+            storage->rle.runs = malloc(columns * sizeof(VoxelRun));
+            if (storage->rle.column_start == NULL || storage->rle.runs == NULL) {
+                free(storage->rle.column_start);
+                free(storage->rle.runs);
+                return 0;
+            }
+            for (unsigned int column = 0; column <= columns; column++) { storage->rle.column_start[column] = column; }
+            for (unsigned int column = 0; column < columns; column++) { storage->rle.runs[column] = (VoxelRun) { fill, storage->edge }; }
+            storage->rle.run_count = columns;
+            storage->rle.run_capacity = columns;
+            break;
+        }
+        case STORAGE_TREE:
+            if (!initTree(&storage->tree, storage->edge)) { return 0; }
+            if (fill == 0) { break; }
+            for (unsigned int x = 0; x < storage->edge; x++) {
+                for (unsigned int y = 0; y < storage->edge; y++) {
+                    for (unsigned int z = 0; z < storage->edge; z++) {
+                        if (!setTreeVoxel(&storage->tree, x, y, z, fill)) { freeTree(&storage->tree); return 0; }
+                    }
+                }
+            }
+            break;
+        case STORAGE_UNIFORM:
+            storage->uniform = fill;
+            break;
+    }
+
+    trackMemory(MEMORY_CHUNK_VOXELS, getStorageBytes(storage));
+    return 1;
+}
+
+void freeStorage(ChunkStorage *storage) {
+    trackMemory(MEMORY_CHUNK_VOXELS, -(long long) getStorageBytes(storage));
+
+    switch (storage->mode) {
+        case STORAGE_FLAT:
+            free(storage->flat);
+            storage->flat = NULL;
+            break;
+        case STORAGE_PALETTE:
+            free(storage->palette.palette);
+            free(storage->palette.data);
+            storage->palette.palette = NULL;
+            storage->palette.data = NULL;
+            break;
+        case STORAGE_RLE:
+            free(storage->rle.column_start);
+            free(storage->rle.runs);
+            storage->rle.column_start = NULL;
+            storage->rle.runs = NULL;
+            break;
+        case STORAGE_TREE:
+            freeTree(&storage->tree);
+            break;
+        case STORAGE_UNIFORM:
+            break;
+    }
+}
+
+Voxel getRLEVoxel(ChunkStorage *storage, unsigned int index) {
+    unsigned int column = getStorageColumn(storage, index);
+    unsigned int y = getStorageColumnY(storage, index);
+
+    VoxelRun *run = storage->rle.runs + storage->rle.column_start[column];
+    for (unsigned int run_end = run->length; run_end <= y; run_end += run->length) { run++; }
+    return run->voxel;
+}
+
+// Decodes the column, writes the voxel, then splices the re-encoded runs back in
+int setRLEVoxel(ChunkStorage *storage, unsigned int index, Voxel voxel) {
+    RLEStorage *rle = &storage->rle;
+    unsigned int column = getStorageColumn(storage, index);
+    unsigned int y = getStorageColumnY(storage, index);
+
+    Voxel voxels[STORAGE_RLE_MAX_EDGE];
+    unsigned int old_start = rle->column_start[column], old_count = rle->column_start[column + 1] - old_start;
+    for (unsigned int i = 0, column_y = 0; i < old_count; i++) {
+        memset(voxels + column_y, rle->runs[old_start + i].voxel, rle->runs[old_start + i].length);
+        column_y += rle->runs[old_start + i].length;
+    }
+    if (voxels[y] == voxel) { return 1; }
+    voxels[y] = voxel;
+
+    VoxelRun runs[STORAGE_RLE_MAX_EDGE];
+    unsigned int count = 0;
+    for (unsigned int column_y = 0; column_y < storage->edge; column_y++) {
+        if (count > 0 && runs[count - 1].voxel == voxels[column_y]) { runs[count - 1].length++; }
+        else { runs[count++] = (VoxelRun) { voxels[column_y], 1 }; }
+    }
+
+    if (rle->run_count - old_count + count > rle->run_capacity) {
+        size_t old_bytes = getStorageBytes(storage);
+        unsigned int new_capacity = rle->run_capacity * 2;
+        VoxelRun *grown = realloc(rle->runs, new_capacity * sizeof(VoxelRun));
+        if (grown == NULL) {
+            printf("ERROR: Could not grow chunk RLE runs.\n");
+            return 0;
+        }
+        rle->runs = grown;
+        rle->run_capacity = new_capacity;
+        trackMemory(MEMORY_CHUNK_VOXELS, (long long) getStorageBytes(storage) - (long long) old_bytes);
+    }
+
+    unsigned int tail_start = old_start + old_count;
+    memmove(rle->runs + old_start + count, rle->runs + tail_start, (rle->run_count - tail_start) * sizeof(VoxelRun));
+    memcpy(rle->runs + old_start, runs, count * sizeof(VoxelRun));
+    for (unsigned int next = column + 1; next <= storage->edge * storage->edge; next++) { rle->column_start[next] += count - old_count; }
+    rle->run_count += count - old_count;
+
+    return 1;
+}
+
+Voxel getStorageVoxel(ChunkStorage *storage, unsigned int index) {
+    switch (storage->mode) {
+        case STORAGE_FLAT: return storage->flat[index];
+        case STORAGE_PALETTE: return storage->palette.palette[getPaletteIndex(&storage->palette, index)];
+        case STORAGE_RLE: return getRLEVoxel(storage, index);
+        case STORAGE_TREE: return getTreeVoxel(&storage->tree, decodeVoxelX(storage->edge, index), decodeVoxelY(storage->edge, index), decodeVoxelZ(storage->edge, index));
+        case STORAGE_UNIFORM: return storage->uniform;
+    }
+    return 0;
+}
+
+int setStorageVoxel(ChunkStorage *storage, unsigned int index, Voxel voxel) {
+    if (storage->mode == STORAGE_UNIFORM) {
+        if (voxel == storage->uniform) { return 1; }
+        if (!initStorage(storage, storage->expand_mode, storage->volume, storage->uniform)) {
+            printf("ERROR: Could not expand uniform chunk storage.\n");
+            return 0;
+        }
+    }
+
+    switch (storage->mode) {
+        case STORAGE_FLAT:
+            storage->flat[index] = voxel;
+            return 1;
+        case STORAGE_PALETTE: {
+            PaletteStorage *palette = &storage->palette;
+            unsigned int palette_index = 0;
+            while (palette_index < palette->palette_size && palette->palette[palette_index] != voxel) { palette_index++; }
+
+            if (palette_index == palette->palette_size) {
+                if (palette->palette_size == (1u << palette->bits) && !growPalette(storage)) {
+                    printf("ERROR: Could not grow chunk palette.\n");
+                    return 0;
+                }
+                palette->palette[palette->palette_size++] = voxel;
+            }
+
+            setPaletteIndex(palette, index, palette_index);
+            return 1;
+        }
+        case STORAGE_RLE: return setRLEVoxel(storage, index, voxel);
+        case STORAGE_TREE: {
+            size_t old_bytes = getTreeBytes(&storage->tree);
+            if (!setTreeVoxel(&storage->tree, decodeVoxelX(storage->edge, index), decodeVoxelY(storage->edge, index), decodeVoxelZ(storage->edge, index), voxel)) {
+                printf("ERROR: Could not grow chunk tree.\n");
+                return 0;
+            }
+            trackMemory(MEMORY_CHUNK_VOXELS, (long long) getTreeBytes(&storage->tree) - (long long) old_bytes);
+            return 1;
+        }
+        case STORAGE_UNIFORM: break;
+    }
+    return 0;
+}
+
+// Gives back the spare run capacity left over from growing
+void trimRLEStorage(ChunkStorage *storage) {
+    if (storage->rle.run_capacity == storage->rle.run_count) { return; }
+
+    VoxelRun *trimmed = realloc(storage->rle.runs, storage->rle.run_count * sizeof(VoxelRun));
+    if (trimmed == NULL) { return; }
+
+    size_t old_bytes = getStorageBytes(storage);
+    storage->rle.runs = trimmed;
+    storage->rle.run_capacity = storage->rle.run_count;
+    trackMemory(MEMORY_CHUNK_VOXELS, (long long) getStorageBytes(storage) - (long long) old_bytes);
+}
+
+// Builds RLE storage from any other mode in one pass per column, sized exactly
+int encodeRLEStorage(ChunkStorage *storage, ChunkStorage *source) {
+    if (source->edge > STORAGE_RLE_MAX_EDGE) {
+        printf("ERROR: Chunks of %u^3 voxels are too large for RLE storage.\n", source->edge);
+        return 0;
+    }
+    storage->mode = STORAGE_RLE;
+    storage->volume = source->volume;
+    storage->edge = source->edge;
+    storage->expand_mode = default_storage_mode;
+
+    unsigned int columns = storage->edge * storage->edge, run_count = 0;
+    for (unsigned int column = 0; column < columns; column++) {
+        for (unsigned int y = 0; y < storage->edge; y++) {
+            Voxel voxel = getStorageVoxel(source, getStorageColumnIndex(source, column, y));
+            if (y == 0 || voxel != getStorageVoxel(source, getStorageColumnIndex(source, column, y - 1))) { run_count++; }
+        }
+    }
+
+    RLEStorage *rle = &storage->rle;
+    rle->column_start = malloc((columns + 1) * sizeof(uint16_t));
+    rle->runs = malloc(run_count * sizeof(VoxelRun));
+    if (rle->column_start == NULL || rle->runs == NULL) { free(rle->column_start); free(rle->runs); return 0; }
+    rle->run_count = rle->run_capacity = run_count;
+
+    unsigned int run = 0;
+    for (unsigned int column = 0; column < columns; column++) {
+        rle->column_start[column] = run;
+        for (unsigned int y = 0; y < storage->edge; y++) {
+            Voxel voxel = getStorageVoxel(source, getStorageColumnIndex(source, column, y));
+            if (run > rle->column_start[column] && rle->runs[run - 1].voxel == voxel) { rle->runs[run - 1].length++; }
+            else { rle->runs[run++] = (VoxelRun) { voxel, 1 }; }
+        }
+    }
+    rle->column_start[columns] = run;
+
+    trackMemory(MEMORY_CHUNK_VOXELS, getStorageBytes(storage));
+    return 1;
+}
+
+// Re-encodes the voxels in another mode, e.g. once after generating into flat storage. Uniform storage is left as it is
+int convertStorage(ChunkStorage *storage, ChunkStorageMode mode) {
+    if (storage->mode == mode || storage->mode == STORAGE_UNIFORM || mode == STORAGE_UNIFORM) { return 1; }
+
+    ChunkStorage converted;
+    if (mode == STORAGE_RLE) {
+        if (!encodeRLEStorage(&converted, storage)) { return 0; }
+    } else {
+        // Palettes start from the first voxel rather than air, so a solid chunk of two blocks stays at 1 bit. Trees need air
+        Voxel fill = mode == STORAGE_PALETTE ? getStorageVoxel(storage, 0) : 0;
+        if (!initStorage(&converted, mode, storage->volume, fill)) { return 0; }
+        for (unsigned int i = 0; i < storage->volume; i++) {
+            Voxel voxel = getStorageVoxel(storage, i);
+            if (voxel != fill && !setStorageVoxel(&converted, i, voxel)) { freeStorage(&converted); return 0; }
+        }
+    }
+
+    freeStorage(storage);
+    *storage = converted;
+    return 1;
+}
+
+// Drops the voxel array if every voxel is the same block, returns 1 if the storage is uniform afterwards.
+// Otherwise RLE and tree storage are trimmed to their exact size
+int compactStorage(ChunkStorage *storage) {
+    if (storage->mode == STORAGE_UNIFORM) { return 1; }
+
+    Voxel first = getStorageVoxel(storage, 0);
+    if (storage->mode == STORAGE_FLAT) {
+        for (unsigned int i = 1; i < storage->volume; i++) {
+            if (storage->flat[i] != first) { return 0; }
+        }
+    } else if (storage->mode == STORAGE_RLE) {
+        if (storage->rle.run_count != storage->edge * storage->edge) { trimRLEStorage(storage); return 0; } // Some column has more than one run
+        for (unsigned int i = 1; i < storage->rle.run_count; i++) {
+            if (storage->rle.runs[i].voxel != first) { return 0; }
+        }
+    } else {
+        for (unsigned int i = 1; i < storage->volume; i++) {
+            if (getStorageVoxel(storage, i) == first) { continue; }
+            if (storage->mode == STORAGE_TREE) {
+                size_t old_bytes = getTreeBytes(&storage->tree);
+                trimTree(&storage->tree);
+                trackMemory(MEMORY_CHUNK_VOXELS, (long long) getTreeBytes(&storage->tree) - (long long) old_bytes);
+            }
+            return 0;
+        }
+    }
+
+    freeStorage(storage);
+    storage->mode = STORAGE_UNIFORM;
+    storage->uniform = first;
+    return 1;
+}
+
+// Whether the aligned cube of `size` voxels (a power of 2) at voxel (x, y, z), clipped to the storage, holds any non-air voxel.
+// Trees answer from their masks, other modes look at every voxel
+int storageCellAny(ChunkStorage *storage, unsigned int x, unsigned int y, unsigned int z, unsigned int size) {
+    if (storage->mode == STORAGE_TREE) { return treeCellAny(&storage->tree, x, y, z, size); }
+    if (storage->mode == STORAGE_UNIFORM) { return storage->uniform != 0; }
+
+    for (unsigned int cx = x; cx < x + size && cx < storage->edge; cx++) {
+        for (unsigned int cy = y; cy < y + size && cy < storage->edge; cy++) {
+            for (unsigned int cz = z; cz < z + size && cz < storage->edge; cz++) {
+                if (getStorageVoxel(storage, encodeVoxelIndex(storage->edge, cx, cy, cz)) != 0) { return 1; }
+            }
+        }
+    }
+    return 0;
+}
+
+unsigned int countStorageCellsAny(ChunkStorage *storage, unsigned int size) {
+    unsigned int count = 0;
+    for (unsigned int x = 0; x < storage->edge; x += size) {
+        for (unsigned int y = 0; y < storage->edge; y += size) {
+            for (unsigned int z = 0; z < storage->edge; z += size) { count += storageCellAny(storage, x, y, z, size); }
+        }
+    }
+    return count;
+}
+
+// Size of these voxels as trimmed tree storage: the root, a node per non-empty cube of each level in between and a leaf per non-empty 4^3 cube
+size_t getStorageTreeBytes(ChunkStorage *storage) {
+    unsigned int root_size = TREE_BRANCH;
+    for (unsigned int depth = getTreeDepth(storage->edge); depth > 0; depth--) { root_size *= TREE_BRANCH; }
+
+    size_t nodes = 1, leaves = countStorageCellsAny(storage, TREE_BRANCH);
+    for (unsigned int size = TREE_BRANCH * TREE_BRANCH; size < root_size; size *= TREE_BRANCH) { nodes += countStorageCellsAny(storage, size); }
+    return nodes * sizeof(TreeNode) + leaves * sizeof(TreeLeaf);
+}
+
+// The mode to convert freshly generated voxels to. Tree storage costs more than flat once most 4^3 cubes hold something,
+// so only sparse chunks become trees
+ChunkStorageMode chooseStorageMode(ChunkStorage *storage, ChunkStorageMode mode) {
+    if (mode == STORAGE_TREE && getStorageTreeBytes(storage) >= storage->volume * sizeof(Voxel)) { return STORAGE_FLAT; }
+    return mode;
+}
+
+// 0 if the voxel at (x, y, z) is not air, otherwise the size of an aligned air cube containing it
+unsigned int getStorageEmptySize(ChunkStorage *storage, unsigned int x, unsigned int y, unsigned int z) {
+    switch (storage->mode) {
+        case STORAGE_TREE: return getTreeEmptySize(&storage->tree, x, y, z);
+        case STORAGE_UNIFORM: return storage->uniform == 0 ? storage->edge : 0;
+        default: return getStorageVoxel(storage, encodeVoxelIndex(storage->edge, x, y, z)) == 0;
+    }
+}
+
+// Walks a ray (in voxels, origin relative to the storage corner) and returns 1 with the index of the first non-air voxel
+// within max_distance. Each step jumps out of the whole empty cube the ray is in, so trees skip empty space a child at a time
+int raycastStorage(ChunkStorage *storage, const float origin[3], const float dir[3], float max_distance, unsigned int *hit_index) {
+    float edge = storage->edge;
+    float t = 0, t_exit = max_distance;
+
+    // Clip to the storage cube
+    for (int axis = 0; axis < 3; axis++) {
+        if (dir[axis] == 0) {
+            if (origin[axis] < 0 || origin[axis] >= edge) { return 0; }
+            continue;
+        }
+        float t0 = -origin[axis] / dir[axis], t1 = (edge - origin[axis]) / dir[axis];
+        if (t0 > t1) { float swap = t0; t0 = t1; t1 = swap; }
+        if (t0 > t) { t = t0; }
+        if (t1 < t_exit) { t_exit = t1; }
+    }
+
+    while (t < t_exit) {
+        unsigned int voxel[3];
+        for (int axis = 0; axis < 3; axis++) {
+            int coord = (int) floorf(origin[axis] + dir[axis] * t);
+            voxel[axis] = coord < 0 ? 0 : (coord >= (int) edge ? edge - 1 : coord);
+        }
+
+        unsigned int empty_size = getStorageEmptySize(storage, voxel[0], voxel[1], voxel[2]);
+        if (empty_size == 0) {
+            *hit_index = encodeVoxelIndex(storage->edge, voxel[0], voxel[1], voxel[2]);
+            return 1;
+        }
+
+        // Advance to where the ray leaves the empty cube, nudged past the boundary
+        float t_next = t_exit;
+        for (int axis = 0; axis < 3; axis++) {
+            if (dir[axis] == 0) { continue; }
+            float cube_min = voxel[axis] / empty_size * empty_size;
+            float boundary = dir[axis] > 0 ? cube_min + empty_size : cube_min;
+            float t_axis = (boundary - origin[axis]) / dir[axis];
+            if (t_axis < t_next) { t_next = t_axis; }
+        }
+        t = (t_next > t ? t_next : t) + 1e-4f;
+    }
+
+    return 0;
+}
+
+// Walks one (x, z) column bottom to top a run at a time:
+//     ColumnRunIterator it = beginColumnRuns(storage, column);
+//     while (nextColumnRun(&it)) { ... it.voxel, it.y, it.length ... }
+typedef struct ColumnRunIterator {
+    ChunkStorage *storage;
+    unsigned int column;
+    unsigned int next_run; // RLE only
+    unsigned int next_y;
+    // Current run
+    Voxel voxel;
+    unsigned int y;
+    unsigned int length;
+} ColumnRunIterator;
+
+ColumnRunIterator beginColumnRuns(ChunkStorage *storage, unsigned int column) {
+    return (ColumnRunIterator) {
+        .storage = storage,
+        .column = column,
+        .next_run = storage->mode == STORAGE_RLE ? storage->rle.column_start[column] : 0
+    };
+}
+
+int nextColumnRun(ColumnRunIterator *it) {
+    ChunkStorage *storage = it->storage;
+    if (it->next_y >= storage->edge) { return 0; }
+
+    it->y = it->next_y;
+    switch (storage->mode) {
+        case STORAGE_RLE:
+            it->voxel = storage->rle.runs[it->next_run].voxel;
+            it->length = storage->rle.runs[it->next_run].length;
+            it->next_run++;
+            break;
+        case STORAGE_UNIFORM:
+            it->voxel = storage->uniform;
+            it->length = storage->edge;
+            break;
+        default:
+            // Rebuild the run from individual voxels
+            it->voxel = getStorageVoxel(storage, getStorageColumnIndex(storage, it->column, it->y));
+            it->length = 1;
+            while (it->y + it->length < storage->edge && getStorageVoxel(storage, getStorageColumnIndex(storage, it->column, it->y + it->length)) == it->voxel) { it->length++; }
+            break;
+    }
+    it->next_y = it->y + it->length;
+
+    return 1;
+}
+
+#endif
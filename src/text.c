@@ -169,6 +169,7 @@ void renderText(VertexBufferBundle *bundle, ProgramBundle *program, char *text,
 
     // Cannot use the render function since we need to bind the texture
     glUseProgram(program->programID);
+    incrementCounter(COUNTER_PROGRAM_BINDS, 1);
     applyUniforms(program);
 
     glActiveTexture(GL_TEXTURE0);
@@ -198,6 +199,7 @@ void renderText(VertexBufferBundle *bundle, ProgramBundle *program, char *text,
         glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * 4 * 4, vertices);
 
         glDrawElements(GL_TRIANGLES, bundle->length, GL_UNSIGNED_INT, 0);
+        incrementCounter(COUNTER_DRAW_CALLS, 1);
 
         pos[0] += (ch.advance >> 6) * scale * CHAR_WIDTH_SCALE;
 
@@ -0,0 +1,100 @@
+#ifndef TRACE
+#define TRACE
+
+#include "vector.c"
+#include "misc.c"
+
+#include "cglm/cglm.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+// Chrome trace event / Perfetto JSON export.
+// Events are appended to an in memory buffer and only formatted when the trace is written,
+// so recording costs a timestamp and a copy. Names must be string literals since only the pointer is kept.
+
+#define TRACE_MAX_EVENTS (1 << 22)
+
+typedef struct TraceEvent {
+    const char *name;
+    double timestamp; // Microseconds since the trace started
+    char phase; // 'B'egin or 'E'nd
+    int tid;
+    int has_chunk;
+    int chunk[4]; // x, y, z, lod
+} TraceEvent;
+
+typedef struct Trace {
+    int enabled;
+    double start_time;
+    Vector events; // TraceEvent
+} Trace;
+
+Trace trace = { .enabled = 0 };
+
+void startTrace() {
+    trace.events = vectorInit(sizeof(TraceEvent), 4096);
+    if (trace.events.vals == NULL) { return; }
+    trace.start_time = getPreciseTimeStamp();
+    trace.enabled = 1;
+}
+
+void pushTraceEvent(TraceEvent *event) {
+    if (trace.events.size >= TRACE_MAX_EVENTS) {
+        printf("WARNING: Trace buffer full, recording stopped.\n");
+        trace.enabled = 0;
+        return;
+    }
+    event->timestamp = (getPreciseTimeStamp() - trace.start_time) * 1.0e6;
+    vectorPush(&trace.events, event);
+}
+
+void traceBegin(const char *name) {
+    if (!trace.enabled) { return; }
+    TraceEvent event = { .name = name, .phase = 'B', .tid = 0, .has_chunk = 0 };
+    pushTraceEvent(&event);
+}
+
+void traceBeginChunk(const char *name, ivec3 chunk_pos, int lod) {
+    if (!trace.enabled) { return; }
+    TraceEvent event = { .name = name, .phase = 'B', .tid = 0, .has_chunk = 1, .chunk = {chunk_pos[0], chunk_pos[1], chunk_pos[2], lod} };
+    pushTraceEvent(&event);
+}
+
+void traceEnd(const char *name) {
+    if (!trace.enabled) { return; }
+    TraceEvent event = { .name = name, .phase = 'E', .tid = 0, .has_chunk = 0 };
+    pushTraceEvent(&event);
+}
+
+int writeTrace(char *path) {
+    trace.enabled = 0;
+
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        int errsv = errno;
+        printf("ERROR: Could not open %s for the trace. (%d: %s)\n", path, errsv, strerror(errsv));
+        freeVector(&trace.events);
+        return 0;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (size_t i = 0; i < trace.events.size; i++) {
+        TraceEvent *event = vectorIndex(&trace.events, i);
+        fprintf(file, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d", event->name, event->phase, event->timestamp, event->tid);
+        if (event->has_chunk) {
+            fprintf(file, ",\"args\":{\"x\":%d,\"y\":%d,\"z\":%d,\"lod\":%d}", event->chunk[0], event->chunk[1], event->chunk[2], event->chunk[3]);
+        }
+        fprintf(file, "}%s\n", i + 1 < trace.events.size ? "," : "");
+    }
+    fprintf(file, "]}\n");
+    fclose(file);
+
+    printf("Wrote %zu trace events to %s\n", trace.events.size, path);
+    freeVector(&trace.events);
+
+    return 1;
+}
+
+#endif
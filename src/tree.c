@@ -0,0 +1,265 @@
+#ifndef TREE
+#define TREE
+
+#include "memory.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Sparse 64-tree: every node splits its cube into 4x4x4 children and keeps a 64 bit mask of the children that are not empty.
+// Only non-empty children exist, so air costs nothing and empty space can be skipped a whole child at a time.
+// The masks of each level double as the "any" occupancy of that LOD, so tree chunks are LOD meshed straight from them.
+// The bottom level are leaves of 4^3 voxels. A value of 0 is empty (BLOCK_AIR).
+//
+// Coordinates are voxels within the tree, child order within a node is (x * 4 + y) * 4 + z.
+
+#define TREE_BRANCH 4
+#define TREE_CHILDREN 64
+
+typedef struct TreeNode {
+    uint64_t mask; // Children that are not empty
+    uint32_t children[TREE_CHILDREN]; // Index into nodes, or into leaves on the level above them. Only valid where mask is set
+} TreeNode;
+
+typedef struct TreeLeaf {
+    uint64_t mask; // Voxels that are not empty
+    uint8_t voxels[TREE_CHILDREN];
+} TreeLeaf;
+
+typedef struct TreeStorage {
+    unsigned int depth; // Node levels above the leaves, the root covers 4^(depth + 1) voxels per axis
+    TreeNode *nodes; // nodes[0] is the root
+    unsigned int node_count;
+    unsigned int node_capacity;
+    TreeLeaf *leaves;
+    unsigned int leaf_count;
+    unsigned int leaf_capacity;
+} TreeStorage;
+
+#define getTreeChild(x, y, z, child_size) (((((x) / (child_size)) % TREE_BRANCH) * TREE_BRANCH + ((y) / (child_size)) % TREE_BRANCH) * TREE_BRANCH + ((z) / (child_size)) % TREE_BRANCH)
+
+// Voxels per axis covered by one child of a node at the given depth (root is 0, leaves are at tree->depth and their children are voxels)
+unsigned int getTreeChildSize(TreeStorage *tree, unsigned int depth) {
+    unsigned int size = 1;
+    for (unsigned int level = depth; level < tree->depth; level++) { size *= TREE_BRANCH; }
+    return size;
+}
+
+size_t getTreeBytes(TreeStorage *tree) {
+    return tree->node_capacity * sizeof(TreeNode) + tree->leaf_capacity * sizeof(TreeLeaf);
+}
+
+// Node levels needed above the leaves to cover edge voxels per axis
+unsigned int getTreeDepth(unsigned int edge) {
+    unsigned int depth = 1;
+    for (unsigned int cover = TREE_BRANCH * TREE_BRANCH; cover < edge; cover *= TREE_BRANCH) { depth++; }
+    return depth;
+}
+
+int initTree(TreeStorage *tree, unsigned int edge) {
+    tree->depth = getTreeDepth(edge);
+
+    tree->node_capacity = 1;
+    tree->nodes = malloc(sizeof(TreeNode));
+    if (tree->nodes == NULL) { return 0; }
+    tree->nodes[0].mask = 0;
+    tree->node_count = 1;
+
+    tree->leaves = NULL;
+    tree->leaf_count = 0;
+    tree->leaf_capacity = 0;
+
+    return 1;
+}
+
+void freeTree(TreeStorage *tree) {
+    free(tree->nodes);
+    free(tree->leaves);
+    tree->nodes = NULL;
+    tree->leaves = NULL;
+    tree->node_count = tree->node_capacity = 0;
+    tree->leaf_count = tree->leaf_capacity = 0;
+}
+
+// Returns the leaf holding (x, y, z), or NULL if it lies in an empty child
+TreeLeaf *findTreeLeaf(TreeStorage *tree, unsigned int x, unsigned int y, unsigned int z) {
+    TreeNode *node = tree->nodes;
+    for (unsigned int depth = 0; depth < tree->depth; depth++) {
+        unsigned int child = getTreeChild(x, y, z, getTreeChildSize(tree, depth));
+        if (!((node->mask >> child) & 1)) { return NULL; }
+        if (depth + 1 == tree->depth) { return tree->leaves + node->children[child]; }
+        node = tree->nodes + node->children[child];
+    }
+    return NULL;
+}
+
+uint8_t getTreeVoxel(TreeStorage *tree, unsigned int x, unsigned int y, unsigned int z) {
+    TreeLeaf *leaf = findTreeLeaf(tree, x, y, z);
+    if (leaf == NULL) { return 0; }
+    return leaf->voxels[getTreeChild(x, y, z, 1)];
+}
+
+// Appends a node or leaf, doubling the array when full. Returns its index, or -1 if out of memory
+long long pushTreeNode(TreeStorage *tree) {
+    if (tree->node_count == tree->node_capacity) {
+        TreeNode *grown = realloc(tree->nodes, tree->node_capacity * 2 * sizeof(TreeNode));
+        if (grown == NULL) { return -1; }
+        tree->nodes = grown;
+        tree->node_capacity *= 2;
+    }
+    tree->nodes[tree->node_count].mask = 0;
+    return tree->node_count++;
+}
+
+long long pushTreeLeaf(TreeStorage *tree) {
+    if (tree->leaf_count == tree->leaf_capacity) {
+        unsigned int new_capacity = tree->leaf_capacity == 0 ? 4 : tree->leaf_capacity * 2;
+        TreeLeaf *grown = realloc(tree->leaves, new_capacity * sizeof(TreeLeaf));
+        if (grown == NULL) { return -1; }
+        tree->leaves = grown;
+        tree->leaf_capacity = new_capacity;
+    }
+    tree->leaves[tree->leaf_count].mask = 0;
+    memset(tree->leaves[tree->leaf_count].voxels, 0, TREE_CHILDREN);
+    return tree->leaf_count++;
+}
+
+// Creates the path down to the voxel's leaf when writing a non-empty voxel. Emptied leaves and nodes are only unlinked,
+// their slots stay allocated until trimTree. Returns 0 if out of memory
+int setTreeVoxel(TreeStorage *tree, unsigned int x, unsigned int y, unsigned int z, uint8_t voxel) {
+    unsigned int node_index = 0;
+    unsigned int path[8], path_children[8]; // Deep enough for 4^9 voxels per axis
+
+    for (unsigned int depth = 0; depth < tree->depth; depth++) {
+        unsigned int child = getTreeChild(x, y, z, getTreeChildSize(tree, depth));
+        path[depth] = node_index;
+        path_children[depth] = child;
+
+        if (!((tree->nodes[node_index].mask >> child) & 1)) {
+            if (voxel == 0) { return 1; } // Already empty
+
+            long long created = depth + 1 == tree->depth ? pushTreeLeaf(tree) : pushTreeNode(tree);
+            if (created < 0) { return 0; }
+            tree->nodes[node_index].children[child] = created;
+            tree->nodes[node_index].mask |= 1ULL << child;
+        }
+
+        if (depth + 1 == tree->depth) { break; }
+        node_index = tree->nodes[node_index].children[child];
+    }
+
+    TreeLeaf *leaf = tree->leaves + tree->nodes[node_index].children[path_children[tree->depth - 1]];
+    unsigned int voxel_child = getTreeChild(x, y, z, 1);
+    leaf->voxels[voxel_child] = voxel;
+    if (voxel != 0) { leaf->mask |= 1ULL << voxel_child; return 1; }
+
+    leaf->mask &= ~(1ULL << voxel_child);
+    // Unlink children that became empty, bottom up
+    int emptied = leaf->mask == 0;
+    for (int depth = tree->depth - 1; depth >= 0 && emptied; depth--) {
+        TreeNode *node = tree->nodes + path[depth];
+        node->mask &= ~(1ULL << path_children[depth]);
+        emptied = node->mask == 0 && depth > 0;
+    }
+
+    return 1;
+}
+
+// Mask of the n^3 children starting at child coordinates (cx, cy, cz) of a node
+uint64_t getTreeBlockMask(unsigned int cx, unsigned int cy, unsigned int cz, unsigned int n) {
+    uint64_t mask = 0;
+    for (unsigned int x = cx; x < cx + n; x++) {
+        for (unsigned int y = cy; y < cy + n; y++) {
+            for (unsigned int z = cz; z < cz + n; z++) { mask |= 1ULL << ((x * TREE_BRANCH + y) * TREE_BRANCH + z); }
+        }
+    }
+    return mask;
+}
+
+// LOD extraction: whether the aligned cube of `size` voxels (a power of 2) at voxel (x, y, z) holds anything.
+// Answers from the masks of the first level whose children are no larger than the cube
+int treeCellAny(TreeStorage *tree, unsigned int x, unsigned int y, unsigned int z, unsigned int size) {
+    TreeNode *node = tree->nodes;
+    uint64_t mask = node->mask;
+    for (unsigned int depth = 0; depth <= tree->depth; depth++) {
+        unsigned int child_size = getTreeChildSize(tree, depth);
+
+        if (child_size <= size) {
+            unsigned int n = size / child_size > TREE_BRANCH ? TREE_BRANCH : size / child_size;
+            unsigned int node_size = child_size * TREE_BRANCH;
+            return (mask & getTreeBlockMask(x % node_size / child_size, y % node_size / child_size, z % node_size / child_size, n)) != 0;
+        }
+
+        // Never reached on the leaf level, whose children are single voxels
+        unsigned int child = getTreeChild(x, y, z, child_size);
+        if (!((mask >> child) & 1)) { return 0; }
+        if (depth + 1 == tree->depth) { mask = tree->leaves[node->children[child]].mask; }
+        else { node = tree->nodes + node->children[child]; mask = node->mask; }
+    }
+    return 0;
+}
+
+// For ray traversal: if (x, y, z) is empty, returns the size of the largest aligned empty cube around it, else 0
+unsigned int getTreeEmptySize(TreeStorage *tree, unsigned int x, unsigned int y, unsigned int z) {
+    TreeNode *node = tree->nodes;
+    for (unsigned int depth = 0; depth < tree->depth; depth++) {
+        unsigned int child_size = getTreeChildSize(tree, depth);
+        unsigned int child = getTreeChild(x, y, z, child_size);
+        if (!((node->mask >> child) & 1)) { return child_size; }
+
+        if (depth + 1 == tree->depth) {
+            TreeLeaf *leaf = tree->leaves + node->children[child];
+            return (leaf->mask >> getTreeChild(x, y, z, 1)) & 1 ? 0 : 1;
+        }
+        node = tree->nodes + node->children[child];
+    }
+    return 0;
+}
+
+void countTreeNodes(TreeStorage *tree, unsigned int node_index, unsigned int depth, unsigned int *node_count, unsigned int *leaf_count) {
+    TreeNode *node = tree->nodes + node_index;
+    (*node_count)++;
+    for (unsigned int child = 0; child < TREE_CHILDREN; child++) {
+        if (!((node->mask >> child) & 1)) { continue; }
+        if (depth + 1 == tree->depth) { (*leaf_count)++; }
+        else { countTreeNodes(tree, node->children[child], depth + 1, node_count, leaf_count); }
+    }
+}
+
+// Copies the node and everything linked below it into compact, returns its index there
+unsigned int copyTreeNode(TreeStorage *tree, unsigned int node_index, unsigned int depth, TreeStorage *compact) {
+    TreeNode *node = tree->nodes + node_index;
+    unsigned int copy = compact->node_count++;
+    compact->nodes[copy].mask = node->mask;
+    for (unsigned int child = 0; child < TREE_CHILDREN; child++) {
+        if (!((node->mask >> child) & 1)) { continue; }
+        if (depth + 1 == tree->depth) {
+            compact->leaves[compact->leaf_count] = tree->leaves[node->children[child]];
+            compact->nodes[copy].children[child] = compact->leaf_count++;
+        } else {
+            compact->nodes[copy].children[child] = copyTreeNode(tree, node->children[child], depth + 1, compact);
+        }
+    }
+    return copy;
+}
+
+// Rebuilds the tree into exactly sized arrays, which drops the slots setTreeVoxel unlinked along with spare capacity.
+// Left as it is if out of memory
+void trimTree(TreeStorage *tree) {
+    unsigned int node_count = 0, leaf_count = 0;
+    countTreeNodes(tree, 0, 0, &node_count, &leaf_count);
+    if (node_count == tree->node_capacity && leaf_count == tree->leaf_capacity) { return; }
+
+    TreeStorage compact = { .depth = tree->depth, .node_capacity = node_count, .leaf_capacity = leaf_count };
+    compact.nodes = malloc(node_count * sizeof(TreeNode));
+    compact.leaves = leaf_count == 0 ? NULL : malloc(leaf_count * sizeof(TreeLeaf));
+    if (compact.nodes == NULL || (leaf_count != 0 && compact.leaves == NULL)) { free(compact.nodes); free(compact.leaves); return; }
+
+    copyTreeNode(tree, 0, 0, &compact);
+    freeTree(tree);
+    *tree = compact;
+}
+
+#endif
@@ -5,6 +5,9 @@
 #include <string.h>
 #include <stdio.h>
 
+#include "memory.c"
+#include "counters.c"
+
 #define GROWTH_FACTOR 2
 
 // Some general notes:
@@ -16,6 +19,7 @@ typedef struct Vector {
     size_t item_size;
     size_t size;
     size_t capacity;
+    int memory_area; // MemoryArea the allocation is counted against, or MEMORY_UNTRACKED
 } Vector;
 
 void* vectorAllocate(Vector *vector) {
@@ -23,10 +27,11 @@ void* vectorAllocate(Vector *vector) {
 }
 
 int vectorGrow(Vector *vector) {
+    size_t old_capacity = vector->capacity;
     vector->capacity *= GROWTH_FACTOR;
     void *new_vals = vectorAllocate(vector);
     if (new_vals == NULL) { 
-        vector->capacity /= GROWTH_FACTOR;
+        vector->capacity = old_capacity;
         return 0; 
     }
 
@@ -34,15 +39,18 @@ int vectorGrow(Vector *vector) {
     
     free(vector->vals);
     vector->vals = new_vals;
+    trackMemory(vector->memory_area, (long long) (vector->capacity - old_capacity) * vector->item_size);
+    incrementCounter(COUNTER_VECTOR_REALLOCS, 1);
 
     return 1;
 }
 
 int vectorShrink(Vector *vector) {
+    size_t old_capacity = vector->capacity;
     vector->capacity /= GROWTH_FACTOR;
     void *new_vals = vectorAllocate(vector);
     if (new_vals == NULL) { 
-        vector->capacity *= GROWTH_FACTOR;
+        vector->capacity = old_capacity;
         return 0; 
     }
    
@@ -50,6 +58,8 @@ int vectorShrink(Vector *vector) {
     
     free(vector->vals);
     vector->vals = new_vals;
+    trackMemory(vector->memory_area, -(long long) (old_capacity - vector->capacity) * vector->item_size);
+    incrementCounter(COUNTER_VECTOR_REALLOCS, 1);
 
     return 1;
 }
@@ -119,6 +129,22 @@ int vectorPop(Vector *vector, void *dest) {
     return 1;
 }
 
+// Moves the last item into index and shrinks by one, O(1) but does not keep order
+int vectorSwapRemove(Vector *vector, size_t index, void *dest) {
+    if (index >= vector->size) { return 0; }
+
+    void *item = vectorIndex(vector, index);
+    if (dest != NULL) { memcpy(dest, item, vector->item_size); }
+    if (index != vector->size - 1) { memcpy(item, vectorIndex(vector, vector->size - 1), vector->item_size); }
+    vector->size--;
+
+    if (vector->size < vector->capacity / GROWTH_FACTOR) {
+        if (!vectorShrink(vector)) { return 0; }
+    }
+
+    return 1;
+}
+
 // int vectorConcat(Vector *v, Vector *dest) {
 //     if (v->item_size != dest->item_size) { 
 //         printf("ERROR: Attempted to concat incompatable vector types.\n");
@@ -142,6 +168,15 @@ void freeVector(Vector *vector) {
     if (vector->vals == NULL) { return; }
     free(vector->vals);
     vector->vals = NULL;
+    trackMemory(vector->memory_area, -(long long) (vector->capacity * vector->item_size));
+}
+
+// Start counting the vector's allocation against a MemoryArea
+void vectorTrackMemory(Vector *vector, int memory_area) {
+    if (vector->vals == NULL) { return; }
+    trackMemory(vector->memory_area, -(long long) (vector->capacity * vector->item_size));
+    vector->memory_area = memory_area;
+    trackMemory(vector->memory_area, vector->capacity * vector->item_size);
 }
 
 Vector vectorInit(size_t item_size, size_t initial_capacity) {
@@ -149,6 +184,7 @@ Vector vectorInit(size_t item_size, size_t initial_capacity) {
     vector.capacity = initial_capacity;
     vector.item_size = item_size;
     vector.size = 0;
+    vector.memory_area = MEMORY_UNTRACKED;
     vector.vals = vectorAllocate(&vector);
     if (vector.vals == NULL) { printf("ERROR: Failed to allocated space for vector\n"); }
     return vector;
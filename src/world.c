@@ -5,9 +5,12 @@
 #include "cglm/vec3-ext.h"
 #include "cglm/vec3.h"
 #include "chunk.c"
+#include "chunkmap.c"
+#include "region.c"
 #include "engine.c"
 #include "vector.c"
 #include "misc.c"
+#include "profiler.c"
 
 #include "cglm/cglm.h"
 #include <GLFW/glfw3.h>
@@ -18,165 +21,717 @@
 #include <math.h>
 
 typedef struct World {
-    Vector chunks;
+    Vector chunks; // Chunk *, the chunks themselves come from chunk_pool
+    // Hot chunk metadata as parallel arrays, indexed by the same slot as chunks, so renderWorld, the LOD loop in tickWorld
+    // and evictChunks stream these instead of following a pointer per chunk. Copies of the Chunk fields, see syncChunkSlot
+    Vector chunk_positions; // ivec3
+    Vector chunk_lods; // int
+    Vector chunk_meshed; // uint8_t
+    Vector chunk_last_used; // unsigned long, world tick the chunk was last in view or loaded, for eviction
+    Vector chunk_bundles; // SSBOBundle
+    // Region directory, see region.c
+    Vector regions;
+    ChunkMap region_map; // Region position -> index into regions
+    int last_region; // Index of the last region found, most lookups hit the same one
     int render_distance;
     int lod_render_distance;
     int world_height;
-    ivec2 centre_pos;
+    int seed;
+    ivec2 centre_pos; // Follows the camera, the loaded chunks are the 2 * lod_render_distance square around it
+    ivec3 cam_chunk; // Chunk the camera was in last tick
+    MeshSink mesh_sink;
+    // Eviction, see evictChunks
+    long long memory_budget; // Bytes of chunk voxels and GPU buffers, 0 for no limit
+    int unload_distance; // Chunks further than this from the camera chunk (measured as for LOD) are unloaded
+    unsigned long tick;
+    // Fast start, chunks are generated and meshed a few per tick nearest LOD first instead of during population
+    Vector load_queue; // ivec3 chunk positions
+    size_t load_queue_cursor;
+    ivec2 load_queue_centre; // centre_pos when the queue was built
     // Debug
     int chunk_render_count;
+    int streamed_chunk_count; // Per tick
+    int evicted_chunk_count; // Per tick
+    int remeshed_chunk_count; // Per tick
+    double generation_time;
+    double meshing_time;
 } World;
 
 #define worldSize(world) ((world).lod_render_distance * 2 * (world).lod_render_distance * 2 * (world).world_height)
 #define getIndexGivenXYZ(world, x, y, z) ((x + (world.lod_render_distance)) * 2 * (world).lod_render_distance * (world).world_height + (y) * 2 * (world).lod_render_distance + (z + (world).lod_render_distance))
-#define getIndexGivenRelativePos(world, rpos) ((rpos)[0] * 2 * (world).lod_render_distance * (world).world_height + (rpos)[1] * 2 * (world).lod_render_distance + (rpos)[2])
+
+#define getWorldChunk(world, slot) (*(Chunk **) vectorIndex(&(world)->chunks, (slot)))
+
+#define CHUNK_SLOT_VECTOR_COUNT 6
+// Everything indexed by chunk slot, pushed and swap removed together
+#define getChunkSlotVectors(world) {&(world)->chunks, &(world)->chunk_positions, &(world)->chunk_lods, &(world)->chunk_meshed, &(world)->chunk_last_used, &(world)->chunk_bundles}
+
+// Copies the chunk's metadata into its slot, needed whenever the chunk is recycled or (re)meshed
+void syncChunkSlot(World *world, int slot) {
+    Chunk *chunk = getWorldChunk(world, slot);
+    glm_ivec3_copy(chunk->chunk_pos, ((ivec3 *) world->chunk_positions.vals)[slot]);
+    ((int *) world->chunk_lods.vals)[slot] = chunk->lod;
+    ((uint8_t *) world->chunk_meshed.vals)[slot] = chunk->meshed;
+    ((SSBOBundle *) world->chunk_bundles.vals)[slot] = chunk->buffer_bundle;
+}
+
+// Appends the chunk in a new slot, 0 if out of memory
+int pushChunkSlot(World *world, Chunk *chunk) {
+    uint8_t meshed = chunk->meshed;
+    unsigned long last_used = world->tick;
+    Vector *vectors[] = getChunkSlotVectors(world);
+    void *items[] = {&chunk, chunk->chunk_pos, &chunk->lod, &meshed, &last_used, &chunk->buffer_bundle};
+
+    for (int i = 0; i < CHUNK_SLOT_VECTOR_COUNT; i++) {
+        if (vectorPush(vectors[i], items[i])) { continue; }
+        for (int j = 0; j < i; j++) { vectors[j]->size--; } // Keep the slots lined up
+        return 0;
+    }
+
+    return 1;
+}
 
 World *current_world = NULL;
 
+Region *getRegion(World *world, ivec3 region_pos) {
+    if (world->last_region < world->regions.size) {
+        Region *region = vectorIndex(&world->regions, world->last_region);
+        if (glm_ivec3_eqv(region->region_pos, region_pos)) { return region; }
+    }
+
+    int slot = chunkMapGet(&world->region_map, region_pos);
+    if (slot < 0) { return NULL; }
+    world->last_region = slot;
+    return vectorIndex(&world->regions, slot);
+}
+
+// pos is an absolute chunk position, REGION_NO_CHUNK if that chunk is not loaded
+int getChunkSlot(World *world, ivec3 pos) {
+    ivec3 region_pos = getRegionPos(pos);
+    Region *region = getRegion(world, region_pos);
+    if (region == NULL) { return REGION_NO_CHUNK; }
+
+    return region->chunk_slots[getRegionChunkIndex(pos)];
+}
+
+// pos is an absolute chunk position, NULL if that chunk is not loaded
 Chunk *getChunk(World *world, ivec3 pos) {
-    // Assumes static chunks loaded
-    ivec3 relative_pos = {world->lod_render_distance, 0, world->lod_render_distance};
-    glm_ivec3_add(pos, relative_pos, relative_pos);
+    int slot = getChunkSlot(world, pos);
+    if (slot == REGION_NO_CHUNK) { return NULL; }
+    return getWorldChunk(world, slot);
+}
 
-    if (relative_pos[0] < 0 || relative_pos[0] >= world->lod_render_distance * 2 ||
-        relative_pos[1] < 0 || relative_pos[1] >= world->world_height            ||
-        relative_pos[2] < 0 || relative_pos[2] >= world->lod_render_distance * 2   ){
-        return NULL;
+// Points the chunk table entry for chunk_pos at slot, creating its region if needed
+void linkChunk(World *world, ivec3 chunk_pos, int slot) {
+    ivec3 region_pos = getRegionPos(chunk_pos);
+    Region *region = getRegion(world, region_pos);
+    if (region == NULL) {
+        Region *new_region = malloc(sizeof(Region));
+        if (new_region == NULL) { printf("ERROR: Could not allocate region.\n"); return; }
+        initRegion(new_region, region_pos);
+        vectorPush(&world->regions, new_region);
+        free(new_region);
+        chunkMapInsert(&world->region_map, region_pos, world->regions.size - 1);
+        region = vectorIndex(&world->regions, world->regions.size - 1);
     }
-    
-    return vectorIndex(&world->chunks, getIndexGivenRelativePos((*world), relative_pos));
-    //
-    // Slow
-    // for (int i = 0; i < world->chunks.size; i++) {
-    //     Chunk *chunk = vectorIndex(&world->chunks, i);
-    //     if (glm_ivec3_eqv(chunk->chunk_pos, pos)) {
-    //         return chunk;
-    //     }
-    // }
-    // return NULL;
+
+    region->chunk_slots[getRegionChunkIndex(chunk_pos)] = slot;
+    region->chunk_count++;
+}
+
+void removeRegion(World *world, ivec3 region_pos) {
+    int slot = chunkMapGet(&world->region_map, region_pos);
+    if (slot < 0) { return; }
+
+    chunkMapErase(&world->region_map, region_pos);
+    int last = world->regions.size - 1;
+    if (slot != last) { chunkMapInsert(&world->region_map, ((Region *) vectorIndex(&world->regions, last))->region_pos, slot); }
+
+    Region removed;
+    vectorSwapRemove(&world->regions, slot, &removed);
+    world->last_region = 0;
+}
+
+// Clears the chunk table entry for chunk_pos, dropping its region once empty
+void unlinkChunk(World *world, ivec3 chunk_pos) {
+    ivec3 region_pos = getRegionPos(chunk_pos);
+    Region *region = getRegion(world, region_pos);
+    if (region == NULL) { return; }
+
+    region->chunk_slots[getRegionChunkIndex(chunk_pos)] = REGION_NO_CHUNK;
+    region->chunk_count--;
+    if (region->chunk_count == 0) { removeRegion(world, region_pos); }
+}
+
+// Frees the chunk in slot and moves the last chunk into it
+void removeChunk(World *world, int slot) {
+    Chunk *chunk = getWorldChunk(world, slot);
+    unlinkChunk(world, chunk->chunk_pos);
+    freeChunk(chunk);
+
+    int last = world->chunks.size - 1;
+    if (slot != last) {
+        int *moved_pos = ((ivec3 *) world->chunk_positions.vals)[last];
+        ivec3 moved_region_pos = getRegionPos(moved_pos);
+        getRegion(world, moved_region_pos)->chunk_slots[getRegionChunkIndex(moved_pos)] = slot;
+    }
+
+    Vector *vectors[] = getChunkSlotVectors(world);
+    for (int i = 0; i < CHUNK_SLOT_VECTOR_COUNT; i++) { vectorSwapRemove(vectors[i], slot, NULL); }
 }
 
 Voxel getVoxel(ivec3 pos) {
     ivec3 chunk_pos = {divFloor(pos[0], CHUNK_SIZE), divFloor(pos[1], CHUNK_SIZE), divFloor(pos[2], CHUNK_SIZE)};
     Chunk *chunk = getChunk(current_world, chunk_pos);
     
-    if (chunk == NULL) { return EMPTY; }
+    if (chunk == NULL) { return BLOCK_AIR; }
 
     ivec3 pos_in_chunk = {mod(pos[0], CHUNK_SIZE), mod(pos[1], CHUNK_SIZE), mod(pos[2], CHUNK_SIZE)};
     
     int voxel_index = getVoxelIndex(pos_in_chunk[0], pos_in_chunk[1], pos_in_chunk[2]);
-    Voxel voxel = chunk->voxels[voxel_index];
+    Voxel voxel = getChunkVoxel(chunk, voxel_index);
 
     return voxel;
 }
 
+// Whether the LOD cell containing pos is fully opaque, at lod 0 just the voxel
+uint isVoxelOpaque(ivec3 pos, int lod) {
+    ivec3 chunk_pos = {divFloor(pos[0], CHUNK_SIZE), divFloor(pos[1], CHUNK_SIZE), divFloor(pos[2], CHUNK_SIZE)};
+    Chunk *chunk = getChunk(current_world, chunk_pos);
+    
+    if (chunk == NULL) { return 0; }
+
+    return chunkCellFull(chunk, lod, mod(pos[0], CHUNK_SIZE) >> lod, mod(pos[1], CHUNK_SIZE) >> lod, mod(pos[2], CHUNK_SIZE) >> lod);
+}
+
+// Loaded chunks are meshed through these, so their slot picks up the new buffer
+void meshWorldChunk(World *world, int slot) {
+    createChunkMesh(getWorldChunk(world, slot), &isVoxelOpaque, world->mesh_sink);
+    syncChunkSlot(world, slot);
+}
+
+void remeshWorldChunk(World *world, int slot, int lod) {
+    updateChunkLOD(getWorldChunk(world, slot), lod, &isVoxelOpaque, world->mesh_sink);
+    syncChunkSlot(world, slot);
+}
+
 #define IN_CHUNK_OFFSET (CHUNK_SIZE / 2.)
 
+#define DEFERRED_GENERATION_BUDGET 0.004 // Seconds per tick, the chunks generated are then meshed in the same tick
+
 #define CHUNK_MIN_CULL_DISTANCE (2 * CHUNK_SIZE) * (2 * CHUNK_SIZE)
+// View direction culling
+int chunkInView(ivec3 chunk_pos, vec3 view_dir, vec3 cam_pos) {
+    vec3 real_chunk_pos = {chunk_pos[0] * CHUNK_SIZE + IN_CHUNK_OFFSET, chunk_pos[1] * CHUNK_SIZE + IN_CHUNK_OFFSET, chunk_pos[2] * CHUNK_SIZE + IN_CHUNK_OFFSET};
+    vec3 chunk_to_cam; glm_vec3_sub(real_chunk_pos, cam_pos, chunk_to_cam);
+    
+    float cam_distance = chunk_to_cam[0] * chunk_to_cam[0] + chunk_to_cam[1] * chunk_to_cam[1] + chunk_to_cam[2] * chunk_to_cam[2];
+    if (cam_distance > CHUNK_MIN_CULL_DISTANCE) {
+        float dot = glm_vec3_dot(view_dir, chunk_to_cam);
+        if (dot < 0) { return 0; }
+    }
+
+    return 1;
+}
+
 void renderWorld(World *world, ProgramBundle *chunk_program, Chunk **current_chunk_pointer, GLFWwindow *window, vec3 view_dir, vec3 cam_pos) {
     world->chunk_render_count = 0;
+    ivec3 *positions = world->chunk_positions.vals;
+    uint8_t *meshed = world->chunk_meshed.vals;
+    unsigned long *last_used = world->chunk_last_used.vals;
+    SSBOBundle *bundles = world->chunk_bundles.vals;
 
     for (int i = 0; i < world->chunks.size; i++) {
-        Chunk* chunk = vectorIndex(&world->chunks, i);
-        // View direction culling
-        vec3 real_chunk_pos = {chunk->chunk_pos[0] * CHUNK_SIZE + IN_CHUNK_OFFSET, chunk->chunk_pos[1] * CHUNK_SIZE + IN_CHUNK_OFFSET, chunk->chunk_pos[2] * CHUNK_SIZE + IN_CHUNK_OFFSET};
-        vec3 chunk_to_cam; glm_vec3_sub(real_chunk_pos, cam_pos, chunk_to_cam);
-        
-        float cam_distance = chunk_to_cam[0] * chunk_to_cam[0] + chunk_to_cam[1] * chunk_to_cam[1] + chunk_to_cam[2] * chunk_to_cam[2];
-        if (cam_distance > CHUNK_MIN_CULL_DISTANCE) {
-            float dot = glm_vec3_dot(view_dir, chunk_to_cam);
-            if (dot < 0) { continue; }
-        }
+        if (!meshed[i] || !chunkInView(positions[i], view_dir, cam_pos)) { continue; }
+        // Counts as used even without faces, otherwise empty chunks in view are evicted first and generated again straight away
+        last_used[i] = world->tick;
+        if (bundles[i].length == 0) { continue; } // Uniform or fully hidden chunks have nothing to draw
 
-        *current_chunk_pointer = chunk;
-        renderWithSSBOBundle(window, chunk_program, &(chunk->buffer_bundle), 0, chunk->buffer_bundle.length * VERTS_PER_FACE / VALS_PER_VOXEL);
+        *current_chunk_pointer = getWorldChunk(world, i); // Only drawn chunks are read, for their model matrix and LOD scale
+        renderWithSSBOBundle(window, chunk_program, &bundles[i], 0, bundles[i].length * VERTS_PER_FACE / VALS_PER_VOXEL);
         world->chunk_render_count++;
     }
 }
 
-int getChunkLOD(World *world, ivec3 chunk_pos, ivec3 center_pos) {
+// Horizontal distance in chunks, the larger of the x and z offsets
+float getChunkDistance(ivec3 chunk_pos, ivec3 center_pos) {
     float rx = fabs(chunk_pos[0] - center_pos[0] + .5),
           rz = fabs(chunk_pos[2] - center_pos[2] + .5); // Needed to be floats to center world at 0.5 0.5
-    
-    return max(rx / world->render_distance, rz / world->render_distance);
+
+    return max(rx, rz);
+}
+
+int getChunkLOD(World *world, ivec3 chunk_pos, ivec3 center_pos) {
+    return getChunkDistance(chunk_pos, center_pos) / world->render_distance;
 }
 
 void loadChunk(World *world, ivec3 pos, int lod) {
-    Chunk *new_chunk = createChunk((ivec3) {world->centre_pos[0] + pos[0], pos[1], world->centre_pos[1] + pos[2]}, 0, world->world_height, lod);
-    if (new_chunk == NULL) { printf("Error: NULL chunk at (%d %d %d).\n", pos[0], pos[1], pos[2]); return; }
+    ivec3 chunk_pos = {world->centre_pos[0] + pos[0], pos[1], world->centre_pos[1] + pos[2]};
+    traceBeginChunk("loadChunk", chunk_pos, lod);
+    // The chunk and its voxel data come from chunk_pool and chunk_data_pool, only the pointer goes in the chunk vector
+    Chunk *new_chunk = createChunk(chunk_pos, 0, world->world_height, lod, world->seed);
+    if (new_chunk == NULL || !pushChunkSlot(world, new_chunk)) {
+        printf("Error: NULL chunk at (%d %d %d).\n", chunk_pos[0], chunk_pos[1], chunk_pos[2]);
+        if (new_chunk != NULL) { freeChunk(new_chunk); }
+        traceEnd("loadChunk");
+        return;
+    }
 
-    vectorPush(&world->chunks, new_chunk);
-    free(new_chunk);
+    linkChunk(world, chunk_pos, world->chunks.size - 1);
+    traceEnd("loadChunk");
 }
 
-ivec3 current_cam_chunk = {0, 0, 0};
-void tickWorld(World *world, vec3 cam_pos) {
+#define CHUNK_KEPT 0
+#define CHUNK_RECYCLED 1
+#define CHUNK_BORDER 2 // Kept, but next to a chunk that was recycled or dropped
+#define CHUNK_DROPPED 3 // Would wrap to beyond unload_distance, so it is unloaded instead
+
+#define inWindow(x, z, min, size) ((x) >= (min)[0] && (x) < (min)[0] + (size) && (z) >= (min)[1] && (z) < (min)[1] + (size))
+// A column that is in only one of the two squares was either streamed in or recycled away by the move
+#define isStreamedColumn(x, z, old_min, new_min, size) (inWindow(x, z, old_min, size) != inWindow(x, z, new_min, size))
+
+// Whether a kept chunk has a neighbour that was streamed in or recycled away: the new leading edge and the old trailing edge
+int isNextToStreamedColumn(int x, int z, ivec2 old_min, ivec2 new_min, int size) {
+    return isStreamedColumn(x - 1, z, old_min, new_min, size) || isStreamedColumn(x + 1, z, old_min, new_min, size) ||
+        isStreamedColumn(x, z - 1, old_min, new_min, size) || isStreamedColumn(x, z + 1, old_min, new_min, size);
+}
+
+// Moves the loaded square to be centred on centre_pos. The square wraps around like a torus: a chunk that falls off one
+// edge is recycled in place as the chunk entering on the opposite edge, so only the newly exposed rows and columns are
+// generated and the chunk count (and memory) stays constant. Marks each chunk in states as kept, recycled or border
+void recentreWorld(World *world, ivec2 centre_pos, uint8_t *states) {
+    int size = 2 * world->lod_render_distance;
+    ivec2 old_min = {world->centre_pos[0] - world->lod_render_distance, world->centre_pos[1] - world->lod_render_distance};
+    ivec2 new_min = {centre_pos[0] - world->lod_render_distance, centre_pos[1] - world->lod_render_distance};
+    glm_ivec2_copy(centre_pos, world->centre_pos);
     current_world = world;
-    ivec3 new_cam_chunk= {divFloor(cam_pos[0], CHUNK_SIZE), divFloor(cam_pos[1], CHUNK_SIZE), divFloor(cam_pos[2], CHUNK_SIZE)};
 
-    if (glm_ivec3_eqv(current_cam_chunk, new_cam_chunk)) { return; }
-    glm_ivec3_copy(new_cam_chunk, current_cam_chunk);
+    ivec3 *positions = world->chunk_positions.vals;
+    for (int i = 0; i < world->chunks.size; i++) {
+        int x = positions[i][0], z = positions[i][2];
 
-    for (int x = -world->lod_render_distance; x < world->lod_render_distance; x++) {
-        for (int y = 0; y < world->world_height; y++) {
-            for (int z = -world->lod_render_distance; z < world->lod_render_distance; z++) {
-                Chunk *chunk = getChunk(world, (ivec3) {x, y, z});
+        if (inWindow(x, z, new_min, size)) {
+            // Only the edges across the direction of movement gain or lose neighbours
+            states[i] = isNextToStreamedColumn(x, z, old_min, new_min, size) ? CHUNK_BORDER : CHUNK_KEPT;
+            continue;
+        }
+
+        // The wrapped position is never loaded already, it lies outside the old square
+        ivec3 new_pos = {new_min[0] + mod(x - new_min[0], size), positions[i][1], new_min[1] + mod(z - new_min[1], size)};
+        if (getChunkDistance(new_pos, world->cam_chunk) > world->unload_distance) { states[i] = CHUNK_DROPPED; continue; }
+
+        unlinkChunk(world, positions[i]);
+        if (!recycleChunk(getWorldChunk(world, i), new_pos, world->world_height, getChunkLOD(world, new_pos, world->cam_chunk), world->seed)) {
+            printf("ERROR: Could not recycle chunk for (%d %d %d).\n", new_pos[0], new_pos[1], new_pos[2]);
+        }
+        linkChunk(world, new_pos, i);
+        syncChunkSlot(world, i);
+        ((unsigned long *) world->chunk_last_used.vals)[i] = world->tick;
+        states[i] = CHUNK_RECYCLED;
+        world->streamed_chunk_count++;
+    }
+
+    // removeChunk moves the last chunk into the freed slot, so walk down from the end and move its state along with it
+    for (int i = world->chunks.size - 1; i >= 0; i--) {
+        if (states[i] != CHUNK_DROPPED) { continue; }
+        removeChunk(world, i);
+        states[i] = states[world->chunks.size];
+        world->evicted_chunk_count++;
+    }
+
+    // Mesh only once all new chunks exist, so faces between them are culled
+    for (int i = 0; i < world->chunks.size; i++) {
+        if (states[i] == CHUNK_RECYCLED) { meshWorldChunk(world, i); }
+    }
+}
+
+#define getChunkMemory() (memory_stats.current[MEMORY_CHUNK_VOXELS] + memory_stats.current[MEMORY_GPU_SSBO])
+// Eviction goes a little below the budget, so refilling near the camera does not trigger it again straight away
+#define getEvictionTarget(budget) ((budget) - (budget) / 8)
+
+typedef struct EvictionCandidate {
+    ivec3 chunk_pos;
+    int forced; // Beyond unload_distance, unloaded whatever the budget
+    unsigned long last_used;
+    float distance;
+} EvictionCandidate;
+
+// Forced first, then least recently used, then farthest
+int compareEvictionCandidates(const void *a, const void *b) {
+    const EvictionCandidate *x = a, *y = b;
+    if (x->forced != y->forced) { return y->forced - x->forced; }
+    if (x->last_used != y->last_used) { return x->last_used < y->last_used ? -1 : 1; }
+    return (x->distance < y->distance) - (x->distance > y->distance);
+}
+
+// Remeshes the loaded chunks next to chunk_pos, whose faces towards it changed
+void remeshChunkNeighbours(World *world, ivec3 chunk_pos) {
+    for (int face = 0; face < 6; face++) {
+        int slot = getChunkSlot(world, (ivec3) {chunk_pos[0] + face_offsets[face][0], chunk_pos[1] + face_offsets[face][1], chunk_pos[2] + face_offsets[face][2]});
+        if (slot == REGION_NO_CHUNK) { continue; }
+        remeshWorldChunk(world, slot, ((int *) world->chunk_lods.vals)[slot]);
+        world->remeshed_chunk_count++;
+    }
+}
 
-                if (chunk == NULL) { continue; }
+// Unloads every chunk beyond unload_distance. Then, while chunk memory is over the budget, unloads the least recently
+// drawn chunks (farthest first among equals). The LOD 0 area around the camera is never evicted for the budget
+void evictChunks(World *world) {
+    int over_budget = world->memory_budget > 0 && getChunkMemory() > world->memory_budget;
 
-                int lod = getChunkLOD(world, chunk->chunk_pos, new_cam_chunk);
-                
-                if (lod > 4) { continue; } // HOTIFX
+    ivec3 *positions = world->chunk_positions.vals;
+    unsigned long *last_used = world->chunk_last_used.vals;
+    Vector candidates = vectorInit(sizeof(EvictionCandidate), 1);
+    for (int i = 0; i < world->chunks.size; i++) {
+        float distance = getChunkDistance(positions[i], world->cam_chunk);
+        int forced = distance > world->unload_distance;
+        if (!forced && (!over_budget || distance < world->render_distance)) { continue; }
+
+        EvictionCandidate candidate = { .forced = forced, .last_used = last_used[i], .distance = distance };
+        glm_ivec3_copy(positions[i], candidate.chunk_pos);
+        vectorPush(&candidates, &candidate);
+    }
+    if (candidates.size == 0) { freeVector(&candidates); return; }
 
-                if (lod != chunk->lod) {
-                    updateChunkLOD(chunk, lod, &getVoxel);
+    qsort(candidates.vals, candidates.size, sizeof(EvictionCandidate), compareEvictionCandidates);
+
+    size_t evicted = 0;
+    for (; evicted < candidates.size; evicted++) {
+        EvictionCandidate *candidate = vectorIndex(&candidates, evicted);
+        if (!candidate->forced && getChunkMemory() <= getEvictionTarget(world->memory_budget)) { break; }
+
+        removeChunk(world, getChunkSlot(world, candidate->chunk_pos));
+    }
+    world->evicted_chunk_count += evicted;
+
+    // Only once all are gone, so no neighbour is remeshed against a chunk about to go
+    for (size_t i = 0; i < evicted; i++) { remeshChunkNeighbours(world, ((EvictionCandidate *) vectorIndex(&candidates, i))->chunk_pos); }
+
+    freeVector(&candidates);
+}
+
+// Meshes the chunks from slot first_new on, which were just loaded together, then fixes up the faces of the older chunks next to them
+void meshNewChunks(World *world, size_t first_new) {
+    for (size_t i = first_new; i < world->chunks.size; i++) { meshWorldChunk(world, i); }
+    ivec3 *positions = world->chunk_positions.vals;
+    for (size_t i = first_new; i < world->chunks.size; i++) {
+        for (int face = 0; face < 6; face++) {
+            int slot = getChunkSlot(world, (ivec3) {positions[i][0] + face_offsets[face][0], positions[i][1] + face_offsets[face][1], positions[i][2] + face_offsets[face][2]});
+            if (slot == REGION_NO_CHUNK || slot >= first_new) { continue; }
+            remeshWorldChunk(world, slot, ((int *) world->chunk_lods.vals)[slot]);
+            world->remeshed_chunk_count++;
+        }
+    }
+}
+
+// Loads missing chunks of the square within unload_distance, nearest first. Beyond the LOD 0 area they are only
+// loaded while memory is under the eviction target, so evicted chunks come back once the camera gets close again
+void refillChunks(World *world) {
+    if (world->chunks.size >= worldSize(*world)) { return; } // Nothing missing
+    if (world->load_queue_cursor < world->load_queue.size) { return; } // Still populating, loadQueuedChunks covers it
+
+    Vector missing = vectorInit(sizeof(EvictionCandidate), 1);
+    for (int x = world->centre_pos[0] - world->lod_render_distance; x < world->centre_pos[0] + world->lod_render_distance; x++) {
+        for (int z = world->centre_pos[1] - world->lod_render_distance; z < world->centre_pos[1] + world->lod_render_distance; z++) {
+            for (int y = 0; y < world->world_height; y++) {
+                EvictionCandidate candidate = { .chunk_pos = {x, y, z}, .forced = 0, .last_used = 0 };
+                candidate.distance = getChunkDistance(candidate.chunk_pos, world->cam_chunk);
+                if (candidate.distance > world->unload_distance || getChunk(world, candidate.chunk_pos) != NULL) { continue; }
+                vectorPush(&missing, &candidate);
+            }
+        }
+    }
+
+    // Reversed order puts the nearest first
+    qsort(missing.vals, missing.size, sizeof(EvictionCandidate), compareEvictionCandidates);
+
+    size_t first_new = world->chunks.size;
+    for (int i = missing.size - 1; i >= 0; i--) {
+        EvictionCandidate *candidate = vectorIndex(&missing, i);
+        int protected = candidate->distance < world->render_distance;
+        if (!protected && world->memory_budget > 0 && getChunkMemory() >= getEvictionTarget(world->memory_budget)) { break; }
+
+        ivec3 pos = {candidate->chunk_pos[0] - world->centre_pos[0], candidate->chunk_pos[1], candidate->chunk_pos[2] - world->centre_pos[1]};
+        loadChunk(world, pos, getChunkLOD(world, candidate->chunk_pos, world->cam_chunk));
+        world->streamed_chunk_count++;
+    }
+    freeVector(&missing);
+
+    meshNewChunks(world, first_new);
+}
+
+// Fast start: every position of the square, nearest (lowest LOD) first so the area around the camera appears first
+void queueChunkLoads(World *world) {
+    world->load_queue = vectorInit(sizeof(ivec3), worldSize(*world));
+    world->load_queue_cursor = 0;
+    glm_ivec2_copy(world->centre_pos, world->load_queue_centre);
+
+    for (int lod = 0; lod <= CHUNK_MAX_LOD; lod++) {
+        for (int x = -world->lod_render_distance; x < world->lod_render_distance; x++) {
+            for (int y = 0; y < world->world_height; y++) {
+                for (int z = -world->lod_render_distance; z < world->lod_render_distance; z++) {
+                    ivec3 pos = {world->centre_pos[0] + x, y, world->centre_pos[1] + z};
+                    if (getChunkLOD(world, pos, world->cam_chunk) == lod) { vectorPush(&world->load_queue, pos); }
                 }
             }
         }
     }
 }
 
-void populateWorld(World *world) {
+// Generates queued chunks until the time budget is spent, always making progress by at least one chunk
+void loadQueuedChunks(World *world, double budget) {
+    if (world->load_queue_cursor >= world->load_queue.size) { return; }
+
+    int size = 2 * world->lod_render_distance;
+    ivec2 min = {world->centre_pos[0] - world->lod_render_distance, world->centre_pos[1] - world->lod_render_distance};
+    size_t first_new = world->chunks.size;
+    double start = getPreciseTimeStamp();
+    do {
+        ivec3 *pos = vectorIndex(&world->load_queue, world->load_queue_cursor);
+        world->load_queue_cursor++;
+        // The camera may have moved the square since it was queued
+        if (!inWindow((*pos)[0], (*pos)[2], min, size) || getChunkDistance(*pos, world->cam_chunk) > world->unload_distance) { continue; }
+        if (getChunk(world, *pos) != NULL) { continue; }
+        // Beyond the LOD 0 area only while under the eviction target, as in refillChunks. The queue is nearest first, so what is left out is the far LODs
+        int protected = getChunkDistance(*pos, world->cam_chunk) < world->render_distance;
+        if (!protected && world->memory_budget > 0 && getChunkMemory() >= getEvictionTarget(world->memory_budget)) { continue; }
+
+        loadChunk(world, (ivec3) {(*pos)[0] - world->centre_pos[0], (*pos)[1], (*pos)[2] - world->centre_pos[1]}, getChunkLOD(world, *pos, world->cam_chunk));
+        world->streamed_chunk_count++;
+    } while (world->load_queue_cursor < world->load_queue.size && getPreciseTimeStamp() - start < budget);
+
+    double start_meshing = getPreciseTimeStamp();
+    world->generation_time += start_meshing - start;
+    PROFILE_SCOPE(PHASE_REMESH) { meshNewChunks(world, first_new); }
+    world->meshing_time += getPreciseTimeStamp() - start_meshing;
+
+    if (world->load_queue_cursor >= world->load_queue.size) {
+        // The camera moved while populating, queue again for the positions it exposed (loaded ones are skipped)
+        if (world->centre_pos[0] != world->load_queue_centre[0] || world->centre_pos[1] != world->load_queue_centre[1]) {
+            freeVector(&world->load_queue);
+            queueChunkLoads(world);
+            return;
+        }
+
+        printf("Finished queued population of %zu chunks (%f seconds generation, %f seconds meshing).\n", world->chunks.size, world->generation_time, world->meshing_time);
+        freeVector(&world->load_queue);
+        world->load_queue.size = 0;
+        world->load_queue_cursor = 0;
+    }
+}
+
+void tickWorld(World *world, vec3 cam_pos) {
+    current_world = world;
+    world->tick++;
+    world->streamed_chunk_count = 0;
+    world->evicted_chunk_count = 0;
+    world->remeshed_chunk_count = 0;
+
+    loadQueuedChunks(world, DEFERRED_GENERATION_BUDGET);
+
+    ivec3 new_cam_chunk= {divFloor(cam_pos[0], CHUNK_SIZE), divFloor(cam_pos[1], CHUNK_SIZE), divFloor(cam_pos[2], CHUNK_SIZE)};
+
+    if (glm_ivec3_eqv(world->cam_chunk, new_cam_chunk)) {
+        // Memory also grows while the camera stands still (fast start loading), so the budget is checked every tick
+        if (world->memory_budget > 0 && getChunkMemory() > world->memory_budget) { PROFILE_SCOPE(PHASE_STREAM) { evictChunks(world); } }
+        return;
+    }
+    glm_ivec3_copy(new_cam_chunk, world->cam_chunk);
+
+    uint8_t *states = NULL;
+    if (new_cam_chunk[0] != world->centre_pos[0] || new_cam_chunk[2] != world->centre_pos[1]) {
+        states = calloc(world->chunks.size, sizeof(uint8_t));
+        if (states == NULL) { printf("ERROR: Could not allocate chunk states for streaming.\n"); }
+        else { PROFILE_SCOPE(PHASE_STREAM) { recentreWorld(world, (ivec2) {new_cam_chunk[0], new_cam_chunk[2]}, states); } }
+    }
+
+    // Walks the slot arrays, a chunk itself is only touched when it is remeshed
+    ivec3 *positions = world->chunk_positions.vals;
+    int *lods = world->chunk_lods.vals;
+    for (int i = 0; i < world->chunks.size; i++) {
+        int lod = getChunkLOD(world, positions[i], new_cam_chunk);
+        
+        if (lod > CHUNK_MAX_LOD) { continue; } // HOTIFX
+
+        if (lod != lods[i] || (states != NULL && states[i] == CHUNK_BORDER)) {
+            PROFILE_SCOPE(PHASE_REMESH) { remeshWorldChunk(world, i, lod); }
+            world->remeshed_chunk_count++;
+        }
+    }
+
+    free(states);
+
+    PROFILE_SCOPE(PHASE_STREAM) {
+        evictChunks(world);
+        refillChunks(world);
+    }
+}
+
+// Loads the whole square, or with defer only queues it for tickWorld. Set memory_budget first: with a budget the square
+// is loaded nearest first through the same queue, so the far LODs that do not fit are the ones left out
+void populateWorld(World *world, int defer) {
+    traceBegin("populateWorld");
+    current_world = world;
+    if (defer || world->memory_budget > 0) {
+        queueChunkLoads(world);
+        if (defer) { printf("Deferred population of %zu chunks\n", world->load_queue.size); }
+        else { loadQueuedChunks(world, INFINITY); }
+        traceEnd("populateWorld");
+        return;
+    }
+
     int total_world_size = worldSize(*world);
 
-    float start = getTimeStamp();
+    double start = getPreciseTimeStamp();
 
     for (int x = -world->lod_render_distance; x < world->lod_render_distance; x++) {
+        // Progress once per slice, printing per chunk is measurable at large render distances
+        printf("\rCreating chunks: %04.1f", (((float) getIndexGivenXYZ((*world), x, 0, -world->lod_render_distance)) / total_world_size) * 100);
+        fflush(stdout);
+
         for (int y = 0; y < world->world_height; y++) {
             for (int z = -world->lod_render_distance; z < world->lod_render_distance; z++) {
-                printf("\rCreating chunks: %04.1f", (((float) getIndexGivenXYZ((*world), x, y, z)) / total_world_size) * 100);
-
                 int lod = getChunkLOD(world, (ivec3) {x, y, z}, (ivec3) {0, 0, 0});
                 loadChunk(world, (ivec3) {x, y, z}, lod);
             }
         }
     }
 
-    float start_meshing = getTimeStamp();
+    double start_meshing = getPreciseTimeStamp();
+    world->generation_time = start_meshing - start;
 
-    printf("\nPopulation took %f seconds\n", start_meshing - start);
+    printf("\nPopulation took %f seconds\n", world->generation_time);
 
+    for (int i = 0; i < world->chunks.size; i++) {
+        if (i % 256 == 0) { printf("\rMeshing Chunks: %04.1f", ((float) i / world->chunks.size) * 100); fflush(stdout); }
+        meshWorldChunk(world, i);
+    }
+
+    world->meshing_time = getPreciseTimeStamp() - start_meshing;
+    printf("\nMeshing took %f seconds\n", world->meshing_time);
+    printf("Finished world population.\n");
+    traceEnd("populateWorld");
+}
+
+// Chunks bordering a region see it through isVoxelOpaque, so they are remeshed whenever it is loaded or dropped
+void remeshRegionBorder(World *world, ivec3 region_pos) {
+    ivec3 start = {region_pos[0] * REGION_SIZE, region_pos[1] * REGION_SIZE, region_pos[2] * REGION_SIZE};
     current_world = world;
+
+    for (int x = start[0] - 1; x <= start[0] + REGION_SIZE; x++) {
+        for (int y = start[1] - 1; y <= start[1] + REGION_SIZE; y++) {
+            for (int z = start[2] - 1; z <= start[2] + REGION_SIZE; z++) {
+                int inside = x >= start[0] && x < start[0] + REGION_SIZE && y >= start[1] && y < start[1] + REGION_SIZE && z >= start[2] && z < start[2] + REGION_SIZE;
+                if (inside) { continue; }
+
+                int slot = getChunkSlot(world, (ivec3) {x, y, z});
+                if (slot != REGION_NO_CHUNK) { remeshWorldChunk(world, slot, ((int *) world->chunk_lods.vals)[slot]); }
+            }
+        }
+    }
+}
+
+// Drops every chunk in the region, along with the region itself
+void unloadRegion(World *world, ivec3 region_pos) {
+    traceBegin("unloadRegion");
+    Region *region = getRegion(world, region_pos);
+    if (region == NULL) { traceEnd("unloadRegion"); return; }
+
+    for (int i = 0; i < REGION_VOLUME; i++) {
+        // removeChunk can move or free the region, so look it up again each time
+        region = getRegion(world, region_pos);
+        if (region == NULL) { break; }
+        if (region->chunk_slots[i] != REGION_NO_CHUNK) { removeChunk(world, region->chunk_slots[i]); }
+    }
+
+    remeshRegionBorder(world, region_pos);
+    traceEnd("unloadRegion");
+}
+
+// Generates and meshes the missing chunks of the region that lie within the world's bounds
+void loadRegion(World *world, ivec3 region_pos) {
+    traceBegin("loadRegion");
+    current_world = world;
+    ivec3 start = {region_pos[0] * REGION_SIZE, region_pos[1] * REGION_SIZE, region_pos[2] * REGION_SIZE};
+    size_t first_new = world->chunks.size;
+
+    for (int x = start[0]; x < start[0] + REGION_SIZE; x++) {
+        if (x < world->centre_pos[0] - world->lod_render_distance || x >= world->centre_pos[0] + world->lod_render_distance) { continue; }
+
+        for (int y = start[1]; y < start[1] + REGION_SIZE; y++) {
+            if (y < 0 || y >= world->world_height) { continue; }
+
+            for (int z = start[2]; z < start[2] + REGION_SIZE; z++) {
+                if (z < world->centre_pos[1] - world->lod_render_distance || z >= world->centre_pos[1] + world->lod_render_distance) { continue; }
+
+                ivec3 pos = {x, y, z};
+                if (getChunk(world, pos) != NULL) { continue; }
+                // loadChunk takes positions relative to the centre
+                loadChunk(world, (ivec3) {x - world->centre_pos[0], y, z - world->centre_pos[1]}, getChunkLOD(world, pos, world->cam_chunk));
+            }
+        }
+    }
+
+    // Mesh only once the whole region exists, so faces between its chunks are culled. This also remeshes the
+    // chunks bordering the region
+    meshNewChunks(world, first_new);
+    traceEnd("loadRegion");
+}
+
+void freeWorld(World *world) {
     for (int i = 0; i < world->chunks.size; i++) {
-        printf("\rMeshing Chunks: %04.1f", ((float) i / world->chunks.size) * 100);
-        createChunkMesh(vectorIndex(&world->chunks, i), &getVoxel); 
+        freeChunk(getWorldChunk(world, i));
     }
 
-    printf("\nMeshing took %f seconds\n", getTimeStamp() - start_meshing);
+    Vector *vectors[] = getChunkSlotVectors(world);
+    for (int i = 0; i < CHUNK_SLOT_VECTOR_COUNT; i++) {
+        freeVector(vectors[i]);
+        vectors[i]->size = 0;
+    }
+    freeVector(&world->regions);
+    world->regions.size = 0;
+    freeChunkMap(&world->region_map);
+    freeVector(&world->load_queue);
+    world->load_queue.size = 0;
+    // Slabs are kept for the next world while another one is still loaded
+    if (chunk_pool.used == 0) { freePool(&chunk_pool); }
+    if (chunk_data_pool.used == 0) { freePool(&chunk_data_pool); }
 }
 
-World createWorld(int render_distance, int world_height, ivec2 centre_pos, int seed) {
+// Returns an empty world, configure it (memory_budget, unload_distance) and then populateWorld it
+World createWorld(int render_distance, int world_height, ivec2 centre_pos, int seed, MeshSink mesh_sink) {
     World world;
     world.render_distance = render_distance;
     world.lod_render_distance = render_distance * (log2(CHUNK_SIZE) + 1);
     world.world_height = world_height;
-    world.chunks = vectorInit(sizeof(Chunk), worldSize(world));
+    world.seed = seed;
+    glm_ivec3_copy((ivec3) {0, 0, 0}, world.cam_chunk);
+    world.chunks = vectorInit(sizeof(Chunk *), worldSize(world));
+    world.chunk_positions = vectorInit(sizeof(ivec3), worldSize(world));
+    world.chunk_lods = vectorInit(sizeof(int), worldSize(world));
+    world.chunk_meshed = vectorInit(sizeof(uint8_t), worldSize(world));
+    world.chunk_last_used = vectorInit(sizeof(unsigned long), worldSize(world));
+    world.chunk_bundles = vectorInit(sizeof(SSBOBundle), worldSize(world));
+    Vector *vectors[] = getChunkSlotVectors(&world);
+    for (int i = 0; i < CHUNK_SLOT_VECTOR_COUNT; i++) { vectorTrackMemory(vectors[i], MEMORY_CHUNK_VECTOR); }
+    world.regions = vectorInit(sizeof(Region), 1);
+    vectorTrackMemory(&world.regions, MEMORY_CHUNK_INDEX);
+    world.region_map = createChunkMap(1);
+    world.last_region = 0;
     glm_ivec2_copy(centre_pos, world.centre_pos);
+    world.mesh_sink = mesh_sink;
+    world.memory_budget = 0;
+    world.unload_distance = world.lod_render_distance; // The whole loaded square
+    world.tick = 0;
+    world.load_queue = (Vector) { .vals = NULL, .size = 0, .capacity = 0, .item_size = sizeof(ivec3), .memory_area = MEMORY_UNTRACKED };
+    world.load_queue_cursor = 0;
     // Debug
     world.chunk_render_count = 0;
-
-    populateWorld(&world);
-    printf("Finished world population.\n");
+    world.streamed_chunk_count = 0;
+    world.evicted_chunk_count = 0;
+    world.remeshed_chunk_count = 0;
+    world.generation_time = 0;
+    world.meshing_time = 0;
 
     return world;
 }